@@ -0,0 +1,61 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "bearBonesECS.hpp"
+
+// Transform Component, read through the join
+struct Transform {
+    float position[3];
+    float rotation[4];
+    float scale[3];
+    float padding[6];
+};
+
+// Velocity Component, drives the join
+struct Velocity {
+    float x, y, z;
+};
+
+// Times a two component join over a Transform pool that is in a different order than the
+// Velocity pool driving it, once per prefetch distance
+int main() {
+    const size_t entityCount = 1000000;
+    const size_t runs = 10;
+
+    bbECS::ECS ecs;
+    ecs.addComponentType<Transform>()
+       .addComponentType<Velocity>();
+
+    std::vector<size_t> order(entityCount);
+    for (size_t i = 0; i < entityCount; i++) {
+        order[i] = i;
+        ecs.addEntity()
+           .addComponent<Transform>(Transform{});
+    }
+
+    // Velocities are added in a random order so every Transform lookup misses the cache
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    for (size_t i : order) {
+        ecs.addComponent<Velocity>(bbECS::EntityID{i}, 1.0f, 2.0f, 3.0f);
+    }
+
+    for (size_t distance : {0, 2, 4, 8, 16, 32}) {
+        ecs.setPrefetchDistance(distance);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t run = 0; run < runs; run++) {
+            ecs.forEach<Transform, Velocity>([](Transform &transform, Velocity &velocity) {
+                transform.position[0] += velocity.x;
+                transform.position[1] += velocity.y;
+                transform.position[2] += velocity.z;
+            });
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin);
+
+        std::cout << "Prefetch distance " << distance << ": " << elapsed.count() / runs << " ms per loop" << std::endl;
+    }
+
+    return 0;
+}
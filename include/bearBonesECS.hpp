@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <map>
 #include <random>
 #include <iostream>
 #include <functional>
@@ -17,39 +18,108 @@
 #include <thread>
 #include <unordered_set>
 #include <iomanip>
+#include <array>
+#include <bitset>
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <shared_mutex>
+#include <chrono>
+#include <fstream>
+#include <deque>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 // comment this line to disable warning messages
 #define ECS_DEBUG
 
 #ifdef ECS_DEBUG
-#define ECS_WARNING_IF(condition, message, retval) do { if (warnIf(condition, message, __func__)) return retval; } while (0)
+#define ECS_WARNING_IF(condition, message, retval) do { if ((condition) && warnIf(true, message, __func__)) return retval; } while (0)
 #else
 #define ECS_WARNING_IF(condition, message, retval)
 #endif
 
-#define ECS_ERROR_IF(condition, message) errorIf(condition, message, __func__)
+#define ECS_ERROR_IF(condition, message) ((condition) ? (void)errorIf(true, message, __func__) : (void)0)
+
+// like ECS_WARNING_IF, but kept without ECS_DEBUG, for checks that guard memory
+#define ECS_REFUSE_IF(condition, message, retval) do { if (condition) { warnIf(true, message, __func__); return retval; } } while (0)
+
+// how many entities ahead the join loops resolve and prefetch, 0 is off, see ECS::setPrefetchDistance
+#ifndef ECS_PREFETCH_DISTANCE
+#define ECS_PREFETCH_DISTANCE 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ECS_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ECS_PREFETCH(address)
+#endif
+
+// size of the blocks a FrameArena allocates, larger requests get a block of their own
+#ifndef ECS_FRAME_ARENA_BLOCK_SIZE
+#define ECS_FRAME_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+// pools smaller than this are not spread across NUMA nodes
+#ifndef ECS_NUMA_MIN_POOL_BYTES
+#define ECS_NUMA_MIN_POOL_BYTES (1 << 20)
+#endif
+
+// maximum number of component types a single ECS can register
+#ifndef ECS_MAX_COMPONENT_TYPES
+#define ECS_MAX_COMPONENT_TYPES 64
+#endif
 
 #define COMPONENT_TYPE_DOESNT_EXIST(x)          "Component type '" + x +  "' doesn't exist"
 #define COMPONENT_TYPE_ALREADY_EXISTS(x)        "Component type '" + x +  "' already exists"
 #define COMPONENT_TYPE_IS_LOCKED(x)             "Component type '" + x +  "' is locked"
 #define COMPONENT_TYPE_IS_READ_ONLY(x)          "Component type '" + x +  "' is read-only"
+#define COMPONENT_TYPE_IS_GROUPED(x)            "Component type '" + x +  "' is grouped"
 #define ENTITY_DOESNT_EXIST(x)                  "Entity '" + x +  "' doesn't exist"
 #define ENTITY_DOESNT_CONTAIN_COMPONENT(x)      "Entity doesn't contain component '" + x +  "'"
 #define ENTITY_ALREADY_CONTAINS_COMPONENT(x)    "Entity already contains component '" + x +  "'"
 #define ENTITY_ALREADY_EXISTS(x)                "Entity '" + x +  "' already exists"
 #define ENTITY_GUID_ALREADY_EXISTS(x)           "Entity GUID '" + x +  "' already exists"
 #define ENTITY_GUID_DOESNT_EXIST(x)             "Entity GUID '" + x +  "' doesn't exist"
+#define ENTITY_RESERVATIONS_FULL                "No entity slots left to reserve until the next sync point"
+#define ENTITY_RESERVATION_INVALID              "Entity reservation is invalid"
 #define ECS_IS_RESTRICTED                       "ECS is restricted"
 #define SYSTEM_BATCH_DOESNT_EXIST(x)            "System batch '" + x +  "' doesn't exist"
 #define MEMBER_DOESNT_EXIST(x)                  "Member '" + x + "' doesn't exist"
+#define MEMBER_IS_NOT_ARITHMETIC(x)             "Member '" + x + "' is not arithmetic"
+#define SPATIAL_INDEX_DOESNT_EXIST(x)           "Spatial index on '" + x + "' doesn't exist"
+#define SPATIAL_INDEX_ALREADY_EXISTS(x)         "Spatial index on '" + x + "' already exists"
+#define MEMBER_INDEX_DOESNT_EXIST(x)            "Member index on '" + x + "' doesn't exist"
+#define MEMBER_INDEX_ALREADY_EXISTS(x)          "Member index on '" + x + "' already exists"
+#define MEMBER_CANT_BE_INDEXED(x)               "Member '" + x + "' can't be indexed this way"
+#define MEMBER_IS_COLD(x)                       "Member '" + x + "' is cold, only hot members can be indexed"
+#define COMPONENT_TYPE_CANT_BE_SPLIT(x)         "Component type '" + x +  "' can't be split, it must be empty, unindexed, unbuffered, unobserved and trivially copyable"
+#define COMPONENT_TYPE_IS_SPLIT(x)              "Component type '" + x +  "' is split, use getSplitComponent or forEachSplit"
+#define RESOURCE_DOESNT_EXIST(x)                "Resource '" + x + "' doesn't exist"
+#define RESOURCE_IS_LOCKED(x)                   "Resource '" + x + "' is locked"
+#define RESOURCE_IS_READ_ONLY(x)                "Resource '" + x + "' is read-only"
+#define EVENT_TYPE_DOESNT_EXIST(x)              "Event type '" + x + "' doesn't exist"
+#define EVENT_TYPE_ALREADY_EXISTS(x)            "Event type '" + x + "' already exists"
+#define EVENT_CHANNEL_IS_FULL(x)                "Event channel '" + x + "' is full, event dropped until next updateEvents"
+#define COMPONENT_TYPE_NOT_BUFFERED(x)          "Component type '" + x +  "' is not buffered"
+#define ACCESS_TOKEN_NOT_ROOT                   "Access tokens can only be taken on the root ECS"
 #define INVALID_SYSTEM_TYPE                     "Invalid system type"
+#define TOO_MANY_COMPONENT_TYPES                "Too many component types, raise ECS_MAX_COMPONENT_TYPES"
+#define ALIGNMENT_NOT_SUPPORTED(x)              "Alignment '" + x + "' is not supported, it must be a power of two up to alignof(std::max_align_t)"
 
 #define SYSTEM_ADD_COMPONENT 1
 #define SYSTEM_REMOVE_COMPONENT 2
+#define SYSTEM_ADD_COMPONENT_BATCH 3
+#define SYSTEM_REMOVE_COMPONENT_BATCH 4
 
 namespace bbECS { 
 
 class ECS;
+template <typename... Components> class StaticECS;
 
 struct EntityID {
     size_t id;
@@ -63,24 +133,365 @@ struct EntityGUID {
     bool operator==(const EntityGUID& other) const {return id == other.id;}
 };
 
+// Reader/writer lock guarding one component type, or the entity table, against other threads
+struct AccessLock {
+    std::shared_mutex mutex;
+
+    std::atomic<size_t> reads = 0;
+    std::atomic<size_t> writes = 0;
+    std::atomic<size_t> contendedReads = 0;
+    std::atomic<size_t> contendedWrites = 0;
+    std::atomic<uint64_t> waitNanoseconds = 0;
+
+    void lock(bool exclusive);
+    void unlock(bool exclusive);
+};
+
+struct AccessStats {
+    size_t reads;
+    size_t writes;
+    size_t contendedReads;  // acquisitions that had to wait
+    size_t contendedWrites;
+    double waitSeconds;
+};
+
+// Bytes holding data and bytes allocated for one part of an ECS, see ECS::memoryReport
+struct MemoryUsage {
+    size_t used = 0;
+    size_t reserved = 0;
+
+    // share of the reserved bytes that hold nothing
+    double fragmentation() const { return reserved == 0 ? 0.0 : 1.0 - (double)used / (double)reserved; }
+
+    MemoryUsage &operator+=(const MemoryUsage &other) { used += other.used; reserved += other.reserved; return *this; }
+};
+
+struct ComponentTypeMemory {
+    std::string name;
+    MemoryUsage pool;    // components and owners, the cold part of split types included
+    MemoryUsage indexes; // spatial and member indexes
+    MemoryUsage buffers; // published copies of buffered types
+};
+
+// Node based containers are estimated from their element and bucket counts, and systems and 
+// observers only count their std::function, not what their closures allocate themselves
+struct MemoryReport {
+    std::vector<ComponentTypeMemory> componentTypes;
+    MemoryUsage entities;      // the entity table
+    MemoryUsage componentMaps; // the component index map of each entity
+    MemoryUsage guidMap;
+    MemoryUsage hierarchy;     // children lists
+    MemoryUsage reservations;
+    MemoryUsage systemBatches;
+    MemoryUsage observers;
+    MemoryUsage resources;
+    MemoryUsage events;
+    MemoryUsage blobs;         // out of line BlobArray payloads
+    MemoryUsage total;
+};
+
+// Reader or writer access to component types, held until released or destroyed, see ECS::acquireRead
+class AccessToken {
+public:
+    AccessToken() = default;
+    AccessToken(AccessToken &&other) noexcept;
+    AccessToken &operator=(AccessToken &&other) noexcept;
+    AccessToken(const AccessToken &other) = delete;
+    AccessToken &operator=(const AccessToken &other) = delete;
+    ~AccessToken();
+
+    void release();
+
+private:
+    friend class ECS;
+    std::vector<std::pair<AccessLock*, bool>> locks; // lock, exclusive
+};
+
+// A published copy of a buffered component pool, see ECS::setBuffered. The copy stays 
+// untouched until the snapshot is destroyed, whatever the simulation does meanwhile.
+template <typename T>
+class ComponentSnapshot {
+public:
+    ComponentSnapshot() = default;
+    ComponentSnapshot(ComponentSnapshot &&other) noexcept;
+    ComponentSnapshot &operator=(ComponentSnapshot &&other) noexcept;
+    ComponentSnapshot(const ComponentSnapshot &other) = delete;
+    ComponentSnapshot &operator=(const ComponentSnapshot &other) = delete;
+    ~ComponentSnapshot();
+
+    size_t size() const { return count; }
+    const T &operator[](size_t index) const { return *reinterpret_cast<const T*>(storage + index * componentSize); }
+    EntityID getOwner(size_t index) const { return *reinterpret_cast<const EntityID*>(storage + index * componentSize + ownerOffset); }
+
+private:
+    friend class ECS;
+    const uint8_t *storage = nullptr;
+    size_t count = 0;
+    size_t componentSize = 0;
+    size_t ownerOffset = 0;
+    std::atomic<size_t> *readers = nullptr;
+};
+
+// A component of a type split with ECS::setHotMembers, its hot and cold parts live in different 
+// pools so there is no whole T to refer to. Members are reached with get(&T::member), load() and 
+// store() copy the whole component in and out.
+template <typename T>
+class SplitComponent {
+public:
+    template <typename M> M &get(M T::*member) const;
+    T load() const;
+    void store(const T &component) const;
+
+private:
+    friend class ECS;
+    uint8_t *hot = nullptr;
+    uint8_t *cold = nullptr;
+    size_t coldOffset = 0; // sizeof(T) when T isn't split
+};
+
+// Bump allocator for per-tick temporaries, see ECS::frameArena. Nothing is freed on its own,
+// reset() makes every block reusable at once, so once warmed up it stops allocating.
+class FrameArena {
+public:
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    FrameArena() = default;
+    FrameArena(const FrameArena &other) = delete;
+    FrameArena &operator=(const FrameArena &other) = delete;
+    ~FrameArena();
+
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    template <typename T> T *allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+    Marker mark() const { return {block, offset}; }
+    void rewind(Marker marker);
+    void reset() { rewind({}); }
+    size_t reserved() const;
+
+private:
+    struct Block {
+        uint8_t *data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t block = 0; // block being filled
+    size_t offset = 0;
+};
+
+// Lets standard containers allocate from a FrameArena, deallocation is left to FrameArena::reset
+template <typename T>
+struct FrameAllocator {
+    using value_type = T;
+
+    FrameArena *arena;
+
+    FrameAllocator(FrameArena &arena) : arena(&arena) {}
+    template <typename U> FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) { return arena->allocate<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U> bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+struct BlobHeader {
+    uint32_t count = 0;
+    uint32_t handle = UINT32_MAX; // slot in the blob store of the world, UINT32_MAX while inline
+};
+
+// A variable-length component member. Up to InlineCount elements live inside the component,
+// longer arrays move to the blob store of the world, see ECS::blob. Every component added to the 
+// world gets its own copy of the payload, a component built outside of it keeps its slot until 
+// releaseBlob.
+template <typename T, size_t InlineCount = 4>
+struct BlobArray {
+    static_assert(std::is_trivially_copyable_v<T>, "Blob elements are moved with memcpy");
+
+    using value_type = T;
+    static constexpr size_t inlineCount = InlineCount;
+
+    BlobHeader header;
+    alignas(T) uint8_t inlineData[InlineCount > 0 ? InlineCount * sizeof(T) : 1];
+};
+
+template <typename T>
+struct is_blob_array : std::false_type {};
+
+template <typename T, size_t InlineCount>
+struct is_blob_array<BlobArray<T, InlineCount>> : std::true_type {};
+
+// An entity reserved with ECS::reserveEntity, it is created at the next sync point
+struct EntityReservation {
+    EntityGUID guid;
+    size_t slot = SIZE_MAX;
+};
+
+// Position of one reader in an event channel, see ECS::read
+struct EventCursor {
+    size_t next = 0;
+};
+
 using ToStringFunc = std::string (*)(void*, ECS&, int);
 using FromStringFunc = void (*)(void*, std::string, ECS&, int);
+using ToNumberFunc = double (*)(const void*);
+
+enum class MemberIndexType { Hash, Sorted };
+
+// A secondary index over the values of one component member, see ECS::addMemberIndex
+struct MemberIndex {
+    MemberIndexType type;
+    size_t offset;
+    size_t valueTypeID;
+    void *values;
+
+    void (*insert)(MemberIndex&, EntityID, const void*);
+    void (*erase)(MemberIndex&, EntityID);
+    void (*move)(MemberIndex&, EntityID, EntityID);
+    void (*update)(MemberIndex&, EntityID, const void*);
+    void (*find)(const MemberIndex&, const void*, const void*, std::vector<EntityID>&);
+    void (*destroy)(MemberIndex&);
+    MemoryUsage (*memoryUsage)(const MemberIndex&);
+};
+
+using CreateIndexFunc = MemberIndex* (*)(MemberIndexType, size_t);
 
 struct MemberMeta {
     size_t offset;
     size_t size;
     bool isPointer;
     int arraySize;
+    bool isBlob = false; // a BlobArray, released with its component
 
     ToStringFunc toString;
     FromStringFunc fromString;
+    ToNumberFunc toNumber = nullptr; // only set for arithmetic members
+    CreateIndexFunc createIndex = nullptr; // only set for hashable or ordered members
+};
+
+// One entry of a component's compile-time member list, see bbECS::member
+template <typename T, typename M>
+struct MemberDescriptor {
+    using Type = M;
+
+    const char *name;
+    M T::*pointer;
+    int arraySize = 0; // same as for addMemberMeta
+};
+
+// Components can list their members once, in the type:
+//     static constexpr auto members = std::tuple{bbECS::member("x", &Position::x), bbECS::member("y", &Position::y)};
+// addComponentType registers them, and the serializers walk the list directly instead of
+// looking members up by name.
+template <typename T, typename M>
+constexpr MemberDescriptor<T, M> member(const char *name, M T::*pointer, int arraySize = 0) {
+    return {name, pointer, arraySize};
+}
+
+template <typename T, typename = void>
+struct has_member_descriptors : std::false_type {};
+
+template <typename T>
+struct has_member_descriptors<T, std::void_t<decltype(std::tuple_size<std::remove_cv_t<decltype(T::members)>>::value)>> : std::true_type {};
+
+// A member of a component type registered at runtime, see ECS::addComponentType(name, size, alignment, members)
+struct MemberLayout {
+    std::string name;
+    MemberMeta meta; // ECS::makeMemberMeta<M>(offset) for members of type M
 };
 
 using SystemBatchID = uint64_t;
 using ComponentTypeID = size_t;
 using SystemType = uint8_t;
 
+// One bit per registered component type, set when an entity has that component
+using ComponentSignature = std::bitset<ECS_MAX_COMPONENT_TYPES>;
+
+// Query terms for forEach: With<T> requires T without fetching it, Without<T> skips
+// entities that have T, and Optional<T> passes a T* that is null when T is missing.
+template <typename T> struct With {};
+template <typename T> struct Without {};
+template <typename T> struct Optional {};
+
+template <typename T>
+struct QueryTerm {
+    using Type = T;
+    using Arguments = std::tuple<T&>;
+    static constexpr bool isRequired = true;
+    static constexpr bool isExcluded = false;
+    static constexpr bool isFetched = true;
+    static constexpr bool isOptional = false;
+    static constexpr bool isFilter = false;
+};
+
+template <typename T>
+struct QueryTerm<With<T>> {
+    using Type = T;
+    using Arguments = std::tuple<>;
+    static constexpr bool isRequired = true;
+    static constexpr bool isExcluded = false;
+    static constexpr bool isFetched = false;
+    static constexpr bool isOptional = false;
+    static constexpr bool isFilter = true;
+};
+
+template <typename T>
+struct QueryTerm<Without<T>> {
+    using Type = T;
+    using Arguments = std::tuple<>;
+    static constexpr bool isRequired = false;
+    static constexpr bool isExcluded = true;
+    static constexpr bool isFetched = false;
+    static constexpr bool isOptional = false;
+    static constexpr bool isFilter = true;
+};
+
+template <typename T>
+struct QueryTerm<Optional<T>> {
+    using Type = T;
+    using Arguments = std::tuple<T*>;
+    static constexpr bool isRequired = false;
+    static constexpr bool isExcluded = false;
+    static constexpr bool isFetched = true;
+    static constexpr bool isOptional = true;
+    static constexpr bool isFilter = true;
+};
+
+// The callback arguments produced by a list of query terms
+template <typename... Terms>
+using QueryArguments = decltype(std::tuple_cat(std::declval<typename QueryTerm<Terms>::Arguments>()...));
+
+template <typename... Terms>
+struct is_filtered_query : std::bool_constant<(QueryTerm<Terms>::isFilter || ...)> {};
+
+template <typename T, typename = void>
+struct is_hashable : std::false_type {};
+
+template <typename T>
+struct is_hashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>())),
+                                  decltype(std::declval<const T&>() == std::declval<const T&>())>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_less_comparable : std::false_type {};
+
+template <typename T>
+struct is_less_comparable<T, std::void_t<decltype(std::declval<const T&>() < std::declval<const T&>())>> 
+    : std::bool_constant<!std::is_array_v<T> && !std::is_pointer_v<T>> {};
+
+template <typename Func, typename Arguments, typename... Prefix>
+struct is_query_invocable;
+
+template <typename Func, typename... Arguments, typename... Prefix>
+struct is_query_invocable<Func, std::tuple<Arguments...>, Prefix...> : std::is_invocable<Func, Prefix..., Arguments...> {};
+
 class ECS {
+    template <typename... Components> friend class StaticECS;
+
     using ComponentID = size_t;
 
     template <typename T>
@@ -92,15 +503,51 @@ class ECS {
     struct Entity {
         EntityGUID guid;
         std::unordered_map<ComponentTypeID, ComponentID> componentIDs;
+        ComponentSignature signature;
         EntityGUID parentGUID;
         std::vector<EntityGUID> childrenGUIDs;
     };
 
+    // Uniform hash grid over up to three arithmetic members of a component
+    struct SpatialIndex {
+        std::vector<MemberMeta> axes;
+        double cellSize;
+        std::unordered_map<uint64_t, std::vector<EntityID>> cells;
+        std::unordered_map<size_t, uint64_t> entityCells;
+    };
+
+    // Writes the indexes of a type haven't picked up yet, shared with split children
+    struct IndexChanges {
+        std::vector<EntityID> entities; // single components written on an unrestricted ECS
+        std::atomic<bool> all = false;  // loops, queries and workers may have written any of them
+    };
+
+    template <typename Map>
+    struct MemberIndexValues {
+        Map values;
+        std::unordered_map<size_t, typename Map::key_type> entityValues;
+    };
+
+    struct ComponentBuffer {
+        void *storage = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+        std::atomic<size_t> readers = 0;
+    };
+
+    // Copies of a pool that swapBuffers publishes for readers on other threads
+    struct BufferedStorage {
+        std::vector<ComponentBuffer> buffers;
+        std::atomic<ComponentBuffer*> published = nullptr;
+    };
+
     struct ComponentType {
         void *storage;
         size_t size;
         size_t componentSize;
+        size_t ownerOffset;
         size_t capacity;
+        size_t index;
         float growthFactor = 1.5f;
 
         bool isLocked = false;
@@ -109,14 +556,132 @@ class ECS {
 
         std::string name;
         std::unordered_map<std::string, MemberMeta> members;
+
+        // Owning group: entities with every type in groupSignature sit at [0, groupSize) of each pool
+        ComponentSignature groupSignature;
+        size_t groupSize = 0;
+
+        SpatialIndex *spatialIndex = nullptr;
+        std::unordered_map<std::string, MemberIndex*> memberIndexes;
+        IndexChanges *indexChanges = nullptr; // created with the first index
+        AccessLock *accessLock = nullptr; // shared with split children
+        BufferedStorage *bufferedStorage = nullptr;
+
+        // Hot/cold split (setHotMembers): the bytes of a component from coldOffset on live in 
+        // coldStorage at the same index, storage only keeps the hot part and the owner
+        void *coldStorage = nullptr;
+        size_t coldOffset = 0;
+        size_t coldSize = 0;
+
+        bool hasBlobs = false; // a BlobArray member is registered
         
-        void (*addComponentFunc)(EntityID, void*, ECS&);
-        void (*removeComponentFunc)(EntityID, ECS&);
+        // Types registered at runtime leave these null, their components are plain bytes that are
+        // copied in and dropped, and serialized member by member
+        size_t dataSize = 0; // bytes of the component, without the owner
+        void (*addComponentFunc)(EntityID, void*, ECS&) = nullptr;
+        void (*destroyFunc)(void*) = nullptr;
+        ToStringFunc toString = nullptr;
+        FromStringFunc fromString = nullptr;
+    };
+
+    // A world-wide singleton, stored in the slot given by getResourceIndex<T>()
+    struct Resource {
+        void *data = nullptr;
+        ComponentTypeID typeID = 0;
+        std::string name;
+
+        bool isLocked = false;
+        bool isReadOnly = false;
+
+        void (*destroyFunc)(void*) = nullptr;
+        size_t size = 0;
+    };
+
+    struct EventBuffer {
+        void *storage = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // Events sent this tick go to current, events from the last tick stay readable in previous.
+    // Senders claim slots with an atomic counter; claimed slots are published at the next sync point.
+    struct EventChannel {
+        EventBuffer previous;
+        EventBuffer current;
+        std::atomic<size_t> reserved = 0;
+        size_t firstEventID = 0; // id of the first event in previous
+        size_t eventSize;
+        std::string name;
+
+        void (*destroyFunc)(EventBuffer&);
+    };
+
+    // Callbacks run when a component of one type is added or removed. Batched observers get the
+    // entities collected in added/removed at the next sync point instead of one call per component.
+    struct ComponentObservers {
+        std::vector<std::function<void(ECS&, EntityID, void*)>> onAdd;
+        std::vector<std::function<void(ECS&, EntityID, void*)>> onRemove;
+        std::vector<std::function<void(ECS&, std::span<const EntityGUID>)>> onAddBatch;
+        std::vector<std::function<void(ECS&, std::span<const EntityGUID>)>> onRemoveBatch;
+
+        std::vector<EntityGUID> added;
+        std::vector<EntityGUID> removed;
+    };
+
+    // Nesting count behind restrict()/unrestrict(). Worker threads read it while the thread that
+    // started them (or a nested parallel forEach) changes it, so it is atomic but stays copyable.
+    struct RestrictionFlag {
+        std::atomic<int> depth = 0;
+
+        RestrictionFlag() = default;
+        RestrictionFlag(bool restricted) : depth(restricted ? 1 : 0) {}
+        RestrictionFlag(const RestrictionFlag &other) : depth(other.depth.load()) {}
+        RestrictionFlag &operator=(const RestrictionFlag &other) { depth = other.depth.load(); return *this; }
+        operator bool() const { return depth.load(std::memory_order_acquire) > 0; }
+    };
+
+    struct ReservedEntity {
+        EntityGUID guid;
+        std::vector<std::function<void(ECS&, EntityID)>> components;
+    };
+
+    // Slots that worker threads claim with an atomic counter. Each slot is only written by the
+    // thread that claimed it, and the slots are only resized while nothing is running.
+    struct EntityReservations {
+        std::vector<ReservedEntity> slots;
+        std::atomic<size_t> reserved = 0;
+    };
+
+    // CPUs of each NUMA node, empty on single node machines
+    struct NumaTopology {
+        std::vector<std::vector<int>> nodeCpus;
+    };
+
+    // Arenas of the root and of the children split off it, owned by the root. Arena 0 is the root's.
+    struct FrameArenas {
+        std::deque<FrameArena> arenas;
+        size_t handedOut = 1;
+        std::mutex mutex;
+    };
+
+    // Out of line BlobArray payloads, owned by the root and shared with split children. Components
+    // only hold slot handles, so compactBlobs can move the bytes without touching the pools.
+    struct BlobStore {
+        struct Slot {
+            size_t offset = 0;
+            size_t capacity = 0; // bytes, 0 while the slot is free
+        };
 
-        void (*removeComponentTypeFunc)(ECS&);
+        std::vector<uint8_t> bytes;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeHandles;
+        size_t wastedBytes = 0; // held by released slots until the next compaction
+    };
 
-        ToStringFunc toString;
-        FromStringFunc fromString;
+    // Tuning shared with split children
+    struct Settings {
+        bool numaAware = false;
+        size_t prefetchDistance = ECS_PREFETCH_DISTANCE;
     };
 
     struct System{
@@ -128,6 +693,32 @@ class ECS {
         std::vector<std::vector<System>> parallelSystems;
     };
 
+    struct Group {
+        std::vector<ComponentTypeID> componentTypeIDs;
+        ComponentSignature signature;
+    };
+
+    // How a join is driven, shared by typed and dynamic queries
+    struct QueryPlan {
+        ComponentSignature requiredSignature;
+        ComponentSignature excludedSignature;
+        ComponentType *driver = nullptr;
+        size_t driverSize = 0;
+        ComponentSignature drivenSignature; // terms whose component index is the driver index
+    };
+
+    template <typename... Terms>
+    struct Query : QueryPlan {
+        std::array<ComponentTypeID, sizeof...(Terms)> typeIDs;
+        std::array<ComponentType*, sizeof...(Terms)> componentTypes;
+    };
+
+    // Terms only known at runtime, each one required and fetched, see forEachDynamic
+    struct DynamicQuery : QueryPlan {
+        std::vector<ComponentTypeID> typeIDs;
+        std::vector<ComponentType*> componentTypes;
+    };
+
 public:
     ECS();
     ~ECS();
@@ -140,6 +731,9 @@ public:
     ECS &addEntity(EntityGUID &guid);
     ECS &removeEntity(EntityGUID entityGUID);
     ECS &removeEntity(EntityID entityID);
+    EntityReservation reserveEntity();
+    ECS &reserveEntitySlots(size_t count);
+    ECS &commitEntities();
 
     ECS &addRelationship(EntityGUID parentEntityGUID, EntityGUID childEntityGUID);
     ECS &addRelationship(EntityID parentEntityID, EntityID childEntityID);
@@ -151,6 +745,8 @@ public:
     std::vector<EntityGUID> getChildren(EntityID entityID);
 
     const EntityID getEntityID(EntityGUID entityGUID) const;
+    ComponentSignature getSignature(EntityGUID entityGUID);
+    ComponentSignature getSignature(EntityID entityID);
     std::string toString(EntityGUID entityGUID);
     std::string toString(EntityID entityID);
     std::string toTemplateString(std::vector<EntityID> entityIDs);
@@ -166,9 +762,15 @@ public:
     template <typename T, typename... Args> ECS &addComponent(Args&&... args);
     template <typename T, typename... Args> ECS &addComponent(EntityGUID entityGUID, Args&&... args);
     template <typename T, typename... Args> ECS &addComponent(EntityID entityID, Args&&... args);
+    template <typename T, typename... Args> ECS &addComponent(EntityReservation reservation, Args&&... args);
     void removeComponent(EntityID entityID, ComponentTypeID componentTypeID);
     template <typename T> ECS &removeComponent(EntityGUID entityID);
     template <typename T> ECS &removeComponent(EntityID entityID);
+    template <typename T, typename Source = T> ECS &addComponents(std::span<const EntityID> entityIDs, Source &&source);
+    template <typename T> ECS &removeComponents(std::span<const EntityID> entityIDs);
+    template <typename T, typename Compare> ECS &sortComponents(Compare compare);
+    template <typename U, typename T> ECS &sortComponentsLike();
+    template <typename... Components> ECS &group();
 
     // Component access
     void* getComponent(EntityID entityID, ComponentTypeID componentTypeID);
@@ -177,9 +779,14 @@ public:
     template <typename T> T &getComponent(EntityID entityID);
     template <typename T> const T &readComponent(EntityGUID entityGUID) const;
     template <typename T> const T &readComponent(EntityID entityID) const;
-    template <typename T> ECS &setReadOnly();
+    template <typename T> SplitComponent<T> getSplitComponent(EntityGUID entityGUID);
+    template <typename T> SplitComponent<T> getSplitComponent(EntityID entityID);
+    template <typename T> ECS &setReadOnly(); // also applies to resources
     template <typename T> ECS &setReadWrite();
     template <typename T> ECS &setSingular();
+    template <typename T> ECS &setBuffered(size_t bufferCount = 2);
+    template <typename T> ComponentSnapshot<T> snapshot();
+    ECS &swapBuffers();
     template <typename T> std::string toString(T &t, int arraySize = 0);
     template <typename U, typename T> std::string toString(T &t, std::string memberName);
     template <typename T> void fromString(T &t, std::string str, int arraySize = 0);
@@ -187,44 +794,208 @@ public:
     // Component type management
     template <typename T> ECS &addComponentType(size_t reserve = 10);
     template <typename T> ECS &addComponentType(std::string name, size_t reserve = 10);
+    ComponentTypeID addComponentType(std::string name, size_t size, size_t alignment, std::vector<MemberLayout> members, size_t reserve = 10);
     template <typename T> ECS &removeComponentType();
+    ECS &removeComponentType(ComponentTypeID typeID);
+    ComponentTypeID getComponentTypeID(std::string name);
     template <typename T> std::string getComponentTypeName();
     template <typename T> ComponentTypeID getComponentTypeID();
+    template <typename... Components> ComponentSignature getSignature();
     template <typename T, typename MemberType>
     ECS &addMemberMeta(MemberType T::*memberPtr, std::string name, int arraySize = 0, 
         ToStringFunc toString = nullptr, FromStringFunc fromString = nullptr);
+    template <typename M> static MemberMeta makeMemberMeta(size_t offset, int arraySize = 0, 
+        ToStringFunc toString = nullptr, FromStringFunc fromString = nullptr);
+    template <typename T, typename M> static size_t getMemberOffset(M T::*memberPtr);
     MemberMeta getMemberMeta(std::string name, ComponentTypeID componentTypeID);
     template <typename T> MemberMeta getMemberMeta(std::string name);
+    template <typename T> ECS &setHotMembers(std::vector<std::string> hotMembers);
+    template <typename M, typename T> M &getMember(EntityID entityID, std::string memberName);
+    template <typename T, typename Func> ECS &forEachSplit(Func func, size_t threadCount = 1);
+
+    // Resources
+    template <typename T, typename... Args> ECS &insertResource(Args&&... args);
+    template <typename T> ECS &removeResource();
+    template <typename T> T &resource();
+    template <typename T> const T &readResource() const;
+    template <typename T> bool hasResource() const;
+
+    // Events
+    template <typename E> ECS &addEventType(size_t reserve = 64);
+    template <typename E, typename... Args> ECS &send(Args&&... args);
+    template <typename E> ECS &read(EventCursor &cursor, std::function<void(const E&)> func);
+    ECS &updateEvents();
+
+    // Spatial indexing
+    template <typename T> ECS &addSpatialIndex(std::vector<std::string> axisMembers, double cellSize);
+    template <typename T> ECS &updateSpatialIndex();
+    template <typename T> std::vector<EntityID> queryAABB(std::array<double, 3> min, std::array<double, 3> max);
+    template <typename T> std::vector<EntityID> queryRadius(std::array<double, 3> center, double radius);
+
+    // Member indexing
+    template <typename T> ECS &addMemberIndex(std::string memberName, MemberIndexType type = MemberIndexType::Hash);
+    template <typename T> ECS &updateMemberIndexes();
+    template <typename T, typename V> std::vector<EntityID> findByMember(std::string memberName, const V &value);
+    template <typename T, typename V> std::vector<EntityID> findByMemberRange(std::string memberName, const V &min, const V &max);
 
     // Looping through components
+    // With threadCount > 1 the ECS is restricted while the workers run. Callbacks may concurrently 
+    // read other components (readComponent, getSignature, getEntityID), read resources, read and 
+    // send events, and start nested loops, none of which mutate shared state. Adding or removing 
+    // entities, components or types is refused until the loop returns.
     template <typename T> ECS &forEach(std::function<void(T&)> func, size_t threadCount = 1);
     template <typename T> ECS &forEach(std::function<void(EntityID, T&)> func, size_t threadCount = 1);
     template <typename T1, typename T2> ECS &forEach(std::function<void(T1&, T2&)> func, size_t threadCount = 1);
     template <typename T1, typename T2> ECS &forEach(std::function<void(EntityID, T1&, T2&)> func, size_t threadCount = 1);
-    template<typename... Components, typename Func, typename = std::enable_if_t<(sizeof...(Components) > 2)>,
-            std::enable_if_t<std::is_invocable_v<Func, Components&...>, long> = 0> 
+    template<typename... Components, typename Func, 
+            typename = std::enable_if_t<(sizeof...(Components) > 2) || is_filtered_query<Components...>::value>,
+            std::enable_if_t<is_query_invocable<Func, QueryArguments<Components...>>::value, long> = 0> 
     ECS &forEach(Func func, size_t threadCount = 1);
-    template<typename... Components, typename Func, typename = std::enable_if_t<(sizeof...(Components) > 2)>,
-            std::enable_if_t<std::is_invocable_v<Func, EntityID, Components&...>, int> = 0> 
+    template<typename... Components, typename Func, 
+            typename = std::enable_if_t<(sizeof...(Components) > 2) || is_filtered_query<Components...>::value>,
+            std::enable_if_t<is_query_invocable<Func, QueryArguments<Components...>, EntityID>::value, int> = 0> 
     ECS &forEach(Func func, size_t threadCount = 1);
+    template <typename... Components, typename Result, typename Map, typename Combine>
+    Result forEachReduce(Result init, Map map, Combine combine, size_t threadCount = 1);
+    // Runtime typed join for scripting and tools, `func(EntityID, void**)` gets one pointer per type in order
+    template <typename Func> ECS &forEachDynamic(std::span<const ComponentTypeID> componentTypeIDs, Func func, size_t threadCount = 1);
+    ECS &setPrefetchDistance(size_t distance);
+
+    // Access from other threads
+    // Tokens let threads outside the system batches read or write component types while the
+    // batches run. Each stage of runSystemBatch takes a write token on the types its systems
+    // declared, and sync points take the whole ECS, so a token only waits for the stages that 
+    // touch its types. acquireWrite<>() with no types is needed to add or remove entities, 
+    // components or types while other threads hold tokens.
+    template <typename... Components> AccessToken acquireRead();
+    template <typename... Components> AccessToken acquireWrite();
+    template <typename T> AccessStats getAccessStats();
+    AccessStats getAccessStats();
+
+    // NUMA
+    // When enabled on a machine with several nodes, large pools are split into one segment per 
+    // node, each first touched by a thread on that node, and parallel loop workers are pinned 
+    // to the node that owns their chunk. Single node machines keep the normal behavior.
+    ECS &setNumaAware(bool enabled = true);
+    size_t getNumaNodeCount();
+
+    // Memory
+    MemoryReport memoryReport() const;
+
+    // Scratch memory
+    // Each split child gets an arena of its own, so a system can use the one of the ECS it is 
+    // handed without locking. Allocations stay valid until the end of the runSystemBatch call 
+    // (the stage for systems), after that the arenas are reused. Parallel forEach workers share
+    // their ECS and must not allocate from it.
+    FrameArena &frameArena();
+    template <typename T> FrameVector<T> frameVector();
+
+    // Blob arrays
+    // Spans stay valid until the next resizeBlob, assignBlob or compactBlobs on the world. Growing
+    // past the inline capacity allocates from the blob store, which needs an unrestricted ECS.
+    // Blob members registered with addMemberMeta are released with their component and serialized.
+    template <typename T, size_t InlineCount> std::span<T> blob(BlobArray<T, InlineCount> &array);
+    template <typename T, size_t InlineCount> std::span<const T> readBlob(const BlobArray<T, InlineCount> &array) const;
+    template <typename T, size_t InlineCount> ECS &resizeBlob(BlobArray<T, InlineCount> &array, size_t count);
+    template <typename T, size_t InlineCount> ECS &assignBlob(BlobArray<T, InlineCount> &array, std::span<const T> values);
+    template <typename T, size_t InlineCount> ECS &releaseBlob(BlobArray<T, InlineCount> &array);
+    ECS &compactBlobs();
 
     // System management
     SystemBatchID addSystemBatch();
     template <typename... Components> ECS &addSystem(SystemBatchID systemBatchID, std::function<void(ECS&)> system);
+    ECS &addSystem(SystemBatchID systemBatchID, std::vector<ComponentTypeID> componentTypeIDs, std::function<void(ECS&)> system);
     template <typename T> ECS &addSystem(SystemType systemType, std::function<void(T&)> system);
     template <typename T> ECS &addSystem(SystemType systemType, std::function<void(EntityID, T&)> system);
     template <typename T> ECS &addSystem(SystemType systemType, std::function<void(ECS&, EntityID, T&)> system);
+    template <typename T> ECS &addSystem(SystemType systemType, std::function<void(ECS&, std::span<const EntityGUID>)> system);
     ECS &runSystemBatch(SystemBatchID systemBatchID);
+    ECS &flushObservers();
 
 private:
     std::string toString(EntityID entityID, EntityGUID parentGUID, std::vector<EntityGUID> childrenGUIDs);
     void fromString(EntityID id, std::string str, std::unordered_map<EntityGUID, EntityGUID> &localToGuid);
     void fromString(std::string str, std::unordered_map<EntityGUID, EntityGUID> &localToGuid);
     template <typename T> static void addComponent(EntityID entityId, void* component, ECS& ecs);
+    ComponentType *prepareAddComponent(EntityID entityID, ComponentTypeID typeID);
+    void commitAddComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType);
+    void placeComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType);
+    template <typename T, typename... Args> static void constructComponent(ComponentType &componentType, ComponentID componentID, Args&&... args);
+    void detachComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType);
+    bool canAddComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType);
+    bool canRemoveComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType);
+    void addRawComponent(EntityID entityID, ComponentTypeID typeID, const void *component);
+    ECS &eraseComponent(EntityID entityID, ComponentTypeID typeID);
+    template <typename T> static void destroyComponent(void *component);
+    static std::string componentToString(ComponentType &componentType, void *data, ECS &ecs);
+    static void componentFromString(ComponentTypeID typeID, void *data, std::string str, ECS &ecs);
     template<typename... Components> std::tuple<Components&...> getComponents(EntityID entityId);
+    template <typename... Terms, typename Func> ECS &forEachQuery(Func &func, size_t threadCount);
+    template <typename QueryType, typename Func> ECS &runQueryInParallel(QueryType &query, Func &func, size_t threadCount);
+    template <typename... Terms> bool prepareQuery(Query<Terms...> &query);
+    bool prepareQuery(DynamicQuery &query, std::span<const ComponentTypeID> componentTypeIDs);
+    void planQuery(QueryPlan &query, std::span<ComponentType* const> componentTypes);
+    bool matchesQuery(const QueryPlan &query, const Entity &entity) const;
+    template <typename... Terms, typename Func> void runQuery(Query<Terms...> &query, Func &func, size_t start, size_t end);
+    template <typename Func> void runQuery(DynamicQuery &query, Func &func, size_t start, size_t end);
+    template <typename... Terms, typename Func> void runQueryPrefetched(Query<Terms...> &query, Func &func, size_t start, size_t end);
+    template <typename Term> static size_t resolveQueryTerm(ComponentType *componentType, ComponentTypeID typeID, 
+                                                            Entity &entity, size_t componentID);
+    template <typename Term> static auto fetchQueryTerm(ComponentType *componentType, ComponentTypeID typeID, 
+                                                         Entity &entity, size_t componentID);
+    static EntityID getOwner(const ComponentType &componentType, size_t componentID);
+    void notifyAdded(ComponentTypeID typeID, EntityID entityID, void *component);
+    void notifyRemoved(ComponentTypeID typeID, EntityID entityID, void *component);
+    void *findObservedComponent(ComponentTypeID typeID, EntityID entityID);
+    void swapComponents(ComponentType &componentType, ComponentTypeID typeID, ComponentID a, ComponentID b);
+    void addToGroup(EntityID entityID, ComponentType &componentType);
+    void removeFromGroup(EntityID entityID, ComponentType &componentType);
+    AccessToken acquire(std::span<const ComponentTypeID> componentTypeIDs, bool write);
+    static AccessStats getAccessStats(const AccessLock &accessLock);
     std::vector<ComponentTypeID> getAllComponentTypeIDs();
-    std::vector<ComponentTypeID> getParallelSystemComponentIDs(SystemBatchID id, size_t index);
+    FrameVector<ComponentTypeID> getParallelSystemComponentIDs(SystemBatchID id, size_t index);
     ECS &killChildren();
+    ECS &sync(std::span<const ComponentTypeID> componentTypeIDs);
+    static void* getComponentPointer(const ComponentType &componentType, ComponentID componentID);
+    template <typename T> static SplitComponent<T> makeSplitComponent(const ComponentType &componentType, ComponentID componentID);
+    template <typename T> static T &loadSplitCopy(const ComponentType &componentType, ComponentID componentID);
+    static void* getColdPointer(const ComponentType &componentType, ComponentID componentID);
+    static void* getMemberPointer(const ComponentType &componentType, ComponentID componentID, const MemberMeta &member);
+    static void copyComponent(ComponentType &componentType, ComponentID from, ComponentID to);
+    static void setOwner(ComponentType &componentType, ComponentID componentID, EntityID owner);
+    static std::array<double, 3> getSpatialPosition(const SpatialIndex &spatialIndex, const void *component);
+    static uint64_t getSpatialCell(const SpatialIndex &spatialIndex, const std::array<double, 3> &position);
+    static void insertIntoSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID, const void *component);
+    static void eraseFromSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID);
+    static void moveInSpatialIndex(SpatialIndex &spatialIndex, EntityID from, EntityID to);
+    static void updateInSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID, const void *component);
+    static void indexComponent(ComponentType &componentType, EntityID entityID, const void *component);
+    static void unindexComponent(ComponentType &componentType, EntityID entityID);
+    static void moveIndexedEntity(ComponentType &componentType, EntityID from, EntityID to);
+    static void reindexComponent(ComponentType &componentType, EntityID entityID, const void *component);
+    void markIndexChanged(ComponentType &componentType, EntityID entityID);
+    static void markIndexesChanged(ComponentType &componentType);
+    void updateIndexes(ComponentTypeID typeID, ComponentType &componentType);
+    template <typename V> static MemberIndex* createMemberIndex(MemberIndexType type, size_t offset);
+    template <typename Map> static MemberIndex* newMemberIndex(MemberIndexType type, size_t offset);
+    template <typename Map> static void insertMemberIndex(MemberIndex &memberIndex, EntityID entityID, const void *component);
+    template <typename Map> static void eraseMemberIndex(MemberIndex &memberIndex, EntityID entityID);
+    template <typename Map> static void moveMemberIndex(MemberIndex &memberIndex, EntityID from, EntityID to);
+    template <typename Map> static void updateMemberIndex(MemberIndex &memberIndex, EntityID entityID, const void *component);
+    template <typename Map> static void findMemberIndex(const MemberIndex &memberIndex, const void *min, const void *max, 
+                                                         std::vector<EntityID> &result);
+    template <typename Map> static void destroyMemberIndex(MemberIndex &memberIndex);
+    template <typename T, typename V> std::vector<EntityID> findByMember(std::string memberName, const V &min, const V &max, bool isRange);
+    template <typename Test> std::vector<EntityID> querySpatialIndex(ComponentTypeID typeID, 
+                                std::array<double, 3> min, std::array<double, 3> max, Test test);
+    template <typename T> static size_t getResourceIndex();
+    template <typename T> static void destroyResource(void *data);
+    Resource *findResource(ComponentTypeID typeID);
+    template <typename E> static size_t getEventIndex();
+    template <typename E> static void destroyEvents(EventBuffer &buffer);
+    template <typename E> EventChannel *getEventChannel();
+    static void reserveEventBuffer(EventBuffer &buffer, size_t eventSize, size_t capacity);
+    void publishEvents();
     template <typename... Args> ECS &split();
     ECS& split(std::vector<ComponentTypeID> componentTypesToLock);
     ECS &terminate();
@@ -232,33 +1003,58 @@ private:
     ECS &unrestrict();
     static EntityGUID generateGUID();
     static SystemBatchID generateSystemBatchID();
-    static void refitComponentTypeStorage(ComponentType& componentType, float growthFactor);
-    static bool haveCommonElements(const std::vector<ComponentTypeID>& vec1, const std::vector<ComponentTypeID>& vec2);
+    static void publishBuffer(ComponentType &componentType);
+    static void deleteBufferedStorage(ComponentType &componentType);
+    static void refitComponentTypeStorage(ComponentType& componentType, float growthFactor, bool numaAware = false);
+    static void resizeComponentTypeStorage(ComponentType& componentType, size_t newCapacity, bool numaAware = false);
+    static const NumaTopology &getNumaTopology();
+    static void firstTouchByNode(void *destination, const void *source, size_t copyBytes, size_t totalBytes);
+    static void bindWorkerToNode(size_t start, size_t end, size_t capacity);
+    uint32_t allocateBlob(size_t bytes);
+    void releaseBlob(BlobHeader &header);
+    void releaseBlobs(ComponentType &componentType, ComponentID componentID);
+    void releaseDetachedBlobs(const ComponentType &componentType, void *component);
+    void copyBlobs(ComponentType &componentType, ComponentID componentID);
+    template <typename Map> static MemoryUsage getMemberIndexMemory(const MemberIndex &memberIndex);
+    template <typename Container> static MemoryUsage getContainerMemory(const Container &container);
+    static bool haveCommonElements(std::span<const ComponentTypeID> vec1, std::span<const ComponentTypeID> vec2);
     static bool warnIf(bool condition, const std::string& message, const char* func);
     static bool errorIf(bool condition, const std::string& message, const char* func);
-    template <typename T> static void removeComponentType_(ECS &ecs);
-    template <typename T> static void removeComponent_(EntityID id, ECS &ecs);
 
     static std::vector<std::string> splitTopLevelCommaSections(const std::string& input);
     template <typename T> static std::string toString(void* data, ECS &ecs, int arraySize = 0);
     template <typename T> static void fromString(void* ptr, std::string str, ECS &ecs, int arraySize = 0);
+    template <typename T> static double toNumber(const void* ptr);
 
     std::unordered_map<EntityGUID, EntityID> *entitiesMap; 
     std::vector<Entity> *entities;
+    EntityReservations *reservations;
+    AccessLock *structureLock = nullptr; // root only
+    FrameArenas *frameArenas = nullptr;
+    FrameArena *arena = nullptr;
+    BlobStore *blobs = nullptr;
     std::unordered_map<ComponentTypeID, ComponentType> componentTypes; 
     std::unordered_map<std::string, ComponentTypeID> componentTypeNames;
+    ComponentSignature componentTypeIndices;
     EntityID cachedEntityID = {SIZE_MAX};
 
+    std::vector<Resource> resources;
+    inline static std::atomic<size_t> resourceCount = 0;
+    std::vector<EventChannel*> eventChannels;
+    inline static std::atomic<size_t> eventTypeCount = 0;
+
     std::unordered_map<SystemBatchID, SystemBatch> systemBatches;
-    std::unordered_map<ComponentTypeID, std::function<void(ECS&, EntityID)>> addComponentSystems;
-    std::unordered_map<ComponentTypeID, std::function<void(ECS&, EntityID)>> removeComponentSystems;
+    std::vector<Group> groups;
+    std::unordered_map<ComponentTypeID, ComponentObservers> observers;
 
-    bool restricted = false;
+    RestrictionFlag restricted;
+    Settings settings;
     bool isRoot = true;
     std::vector<ECS> children;
 
-    ECS(std::unordered_map<EntityGUID, EntityID> *entitiesMap, std::vector<Entity> *entities,
-        std::unordered_map<ComponentTypeID, ComponentType> componentTypes, bool restricted, bool isRoot = false);
+    ECS(std::unordered_map<EntityGUID, EntityID> *entitiesMap, std::vector<Entity> *entities, EntityReservations *reservations,
+        std::unordered_map<ComponentTypeID, ComponentType> componentTypes, std::vector<Resource> resources, 
+        std::vector<EventChannel*> eventChannels, Settings settings, bool restricted, bool isRoot = false);
 };
 }
 namespace std {
@@ -284,13 +1080,24 @@ namespace bbECS {
 ECS::ECS() {
     entitiesMap = new std::unordered_map<EntityGUID, EntityID>();
     entities = new std::vector<Entity>();
+    reservations = new EntityReservations();
+    reservations->slots.resize(64);
+    structureLock = new AccessLock();
+    frameArenas = new FrameArenas();
+    arena = &frameArenas->arenas.emplace_back();
+    blobs = new BlobStore();
 }
 
-ECS::ECS(std::unordered_map<EntityGUID, EntityID> *entitiesMap, std::vector<Entity> *entities,
-                    std::unordered_map<ComponentTypeID, ComponentType> componentTypes, bool restricted, bool isRoot) {
+ECS::ECS(std::unordered_map<EntityGUID, EntityID> *entitiesMap, std::vector<Entity> *entities, EntityReservations *reservations,
+                    std::unordered_map<ComponentTypeID, ComponentType> componentTypes, std::vector<Resource> resources, 
+                    std::vector<EventChannel*> eventChannels, Settings settings, bool restricted, bool isRoot) {
     this->entitiesMap = entitiesMap;
     this->entities = entities;
+    this->reservations = reservations;
     this->componentTypes = componentTypes;
+    this->resources = resources;
+    this->eventChannels = eventChannels;
+    this->settings = settings;
     this->restricted = restricted;
     this->isRoot = isRoot;
 }
@@ -300,6 +1107,10 @@ ECS::~ECS() {
     terminate();
     delete entitiesMap;
     delete entities;
+    delete reservations;
+    delete structureLock;
+    delete frameArenas;
+    delete blobs;
 }
 
 template <typename... Args>
@@ -310,10 +1121,17 @@ ECS &ECS::split(){
 
 ECS& ECS::split(std::vector<ComponentTypeID> componentTypesToLock){
     std::unordered_map<ComponentTypeID, ComponentType> newComponentTypes;
+    std::vector<Resource> newResources = resources;
     
     for(size_t i = 0; i < componentTypesToLock.size(); i++){
         ComponentTypeID typeID = componentTypesToLock[i];
 
+        Resource *resource = findResource(typeID);
+        if(resource != nullptr){
+            ECS_WARNING_IF(resource->isLocked, RESOURCE_IS_LOCKED(resource->name), *this);
+            continue;
+        }
+
         auto componentTypeIt = componentTypes.find(typeID);
         ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
         
@@ -329,24 +1147,66 @@ ECS& ECS::split(std::vector<ComponentTypeID> componentTypesToLock){
         }
     }
 
+    // the child only sees the resources it declared, plus read-only ones
+    for(auto &resource : newResources){
+        bool isDeclared = std::find(componentTypesToLock.begin(), componentTypesToLock.end(), resource.typeID) != componentTypesToLock.end();
+        if(!isDeclared && !resource.isReadOnly){
+            resource.data = nullptr;
+        }
+    }
+
     for(size_t i = 0; i < componentTypesToLock.size(); i++){
+        Resource *resource = findResource(componentTypesToLock[i]);
+        if(resource != nullptr){
+            resource->isLocked = true;
+            continue;
+        }
+
         ComponentType &componentType = componentTypes.at(componentTypesToLock[i]);
         componentType.isLocked = true;
     }
 
     restrict();
-    children.push_back(ECS(entitiesMap, entities, newComponentTypes, true));
-    return children.back();
+    children.push_back(ECS(entitiesMap, entities, reservations, newComponentTypes, newResources, eventChannels, settings, true));
+
+    // children run on threads of their own, so each gets its own arena
+    ECS &child = children.back();
+    child.frameArenas = frameArenas;
+    child.blobs = blobs;
+    {
+        std::lock_guard<std::mutex> lock(frameArenas->mutex);
+        if (frameArenas->handedOut == frameArenas->arenas.size()) {
+            frameArenas->arenas.emplace_back();
+        }
+        child.arena = &frameArenas->arenas[frameArenas->handedOut++];
+    }
+
+    return child;
 }
 
 ECS &ECS::killChildren(){
+    for(size_t i = 0; i < children.size(); i++){
+        unrestrict();
+    }
     children.clear();
+
+    // once the root's children are gone every arena but its own can be handed out again
+    if(isRoot){
+        for(size_t i = 1; i < frameArenas->handedOut; i++){
+            frameArenas->arenas[i].reset();
+        }
+        frameArenas->handedOut = 1;
+    }
     
+    // only the locked types are written, other threads may hold tokens on the rest
     for(auto &componentType : componentTypes){
-        componentType.second.isLocked = false;
+        if(componentType.second.isLocked) componentType.second.isLocked = false;
+    }
+
+    for(auto &resource : resources){
+        if(resource.isLocked) resource.isLocked = false;
     }
     
-    unrestrict();
     return *this;
 }
 
@@ -381,27 +1241,94 @@ ECS &ECS::removeEntity(EntityID entityId) {
     ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
     ECS_WARNING_IF(entityId.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityId.id)), *this);
 
-    std::vector<ComponentTypeID> componentsToRemove;
+    // on the stack rather than in the frame arena, the remove observers may allocate from it
+    std::array<ComponentTypeID, ECS_MAX_COMPONENT_TYPES> componentsToRemove;
+    size_t count = 0;
 
     for (const auto& componentID : (*entities)[entityId.id].componentIDs) {
-        componentsToRemove.push_back(componentID.first);
+        componentsToRemove[count++] = componentID.first;
     }
 
-    for (int i = componentsToRemove.size() - 1; i >= 0; i--) {
-        componentTypes.at(componentsToRemove.at(i)).removeComponentFunc(entityId, *this);
+    for (size_t i = count; i > 0; i--) {
+        eraseComponent(entityId, componentsToRemove[i - 1]);
     }
 
     EntityGUID guid = (*entities)[entityId.id].guid;
-    (*entities)[entityId.id] = (*entities)[entities->size() - 1];
+    EntityID lastEntityID{entities->size() - 1};
+    (*entities)[entityId.id] = (*entities)[lastEntityID.id];
     (*entitiesMap)[(*entities)[entityId.id].guid] = entityId;
     entitiesMap->erase(guid);
     entities->pop_back();
 
+    // The last entity now lives at entityId, point its components back at it
+    if (entityId.id != lastEntityID.id) {
+        for (const auto& componentID : (*entities)[entityId.id].componentIDs) {
+            ComponentType &componentType = componentTypes.at(componentID.first);
+            setOwner(componentType, componentID.second, entityId);
+
+            moveIndexedEntity(componentType, lastEntityID, entityId);
+        }
+    }
+
     cachedEntityID = entityId;
 
     return *this;
 }
 
+// Safe to call from worker threads and systems. The entity and the components added to the 
+// reservation are created at the next sync point, or by commitEntities().
+EntityReservation ECS::reserveEntity() {
+    size_t slot = reservations->reserved.fetch_add(1, std::memory_order_relaxed);
+
+    if (slot >= reservations->slots.size()) {
+        ECS_REFUSE_IF(restricted, ENTITY_RESERVATIONS_FULL, EntityReservation{});
+        reservations->slots.resize(std::max(slot + 1, reservations->slots.size() * 2));
+    }
+
+    ReservedEntity &reservedEntity = reservations->slots[slot];
+    reservedEntity.guid = generateGUID();
+
+    return EntityReservation{reservedEntity.guid, slot};
+}
+
+// Number of entities that can be reserved between two sync points while systems are running
+ECS &ECS::reserveEntitySlots(size_t count) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    if (count > reservations->slots.size()) {
+        reservations->slots.resize(count);
+    }
+
+    return *this;
+}
+
+ECS &ECS::commitEntities() {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    size_t reserved = std::min(reservations->reserved.load(std::memory_order_relaxed), reservations->slots.size());
+    reservations->reserved.store(0, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < reserved; i++) {
+        ReservedEntity &reservedEntity = reservations->slots[i];
+        if (reservedEntity.guid.id == 0) continue; // dropped while the slots were full
+
+        EntityGUID guid = reservedEntity.guid;
+        addEntity(guid);
+
+        // moved out first, the components can be added to an entity that reserves more
+        std::vector<std::function<void(ECS&, EntityID)>> components;
+        std::swap(components, reservedEntity.components);
+        reservedEntity.guid = EntityGUID{};
+
+        EntityID entityID = getEntityID(guid);
+        for (auto &addComponentFunc : components) {
+            addComponentFunc(*this, entityID);
+        }
+    }
+
+    return *this;
+}
+
 ECS &ECS::addRelationship(EntityGUID parent, EntityGUID child){
     ECS_WARNING_IF(entitiesMap->find(parent) == entitiesMap->end(), ENTITY_GUID_DOESNT_EXIST(std::to_string(parent.id)), *this);
     ECS_WARNING_IF(entitiesMap->find(child) == entitiesMap->end(), ENTITY_GUID_DOESNT_EXIST(std::to_string(child.id)), *this);
@@ -493,6 +1420,15 @@ const EntityID ECS::getEntityID(EntityGUID guid) const{
     return entityIt->second;
 }
 
+ComponentSignature ECS::getSignature(EntityGUID guid){
+    return getSignature(getEntityID(guid));
+}
+ComponentSignature ECS::getSignature(EntityID entityID){
+    ECS_WARNING_IF(entityID.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), ComponentSignature{});
+
+    return (*entities)[entityID.id].signature;
+}
+
 void ECS::addComponent(EntityID entityId, ComponentTypeID typeID, void* component){
     ECS_ERROR_IF(restricted, ECS_IS_RESTRICTED);
 
@@ -503,7 +1439,11 @@ void ECS::addComponent(EntityID entityId, ComponentTypeID typeID, void* componen
 
     ComponentType& componentType = componentTypeIt->second;
 
-    componentType.addComponentFunc(entityId, component, *this);
+    if (componentType.addComponentFunc != nullptr) {
+        componentType.addComponentFunc(entityId, component, *this);
+    } else {
+        addRawComponent(entityId, typeID, component);
+    }
 }
 
 template <typename T> void ECS::addComponent(EntityID entityId, void* component, ECS& ecs){
@@ -537,46 +1477,131 @@ template <typename T, typename... Args>
 ECS &ECS::addComponent(EntityID entityId, Args&&... args) {
     ComponentTypeID typeID = typeid(T).hash_code();
 
-    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    ComponentType *componentType = prepareAddComponent(entityId, typeID);
+    if (componentType == nullptr) {
+        return *this;
+    }
 
-    ECS_WARNING_IF(entityId.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityId.id)), *this);
+    constructComponent<T>(*componentType, componentType->size, std::forward<Args>(args)...);
+    commitAddComponent(entityId, typeID, *componentType);
+
+    return *this;
+}
+
+// Builds T in the unused slot componentID of the pool
+template <typename T, typename... Args>
+void ECS::constructComponent(ComponentType &componentType, ComponentID componentID, Args&&... args) {
+    void* componentPtr = getComponentPointer(componentType, componentID);
+
+    if (componentType.coldSize > 0) {
+        // split types are trivially copyable, the whole component is built and copied out in two parts
+        T component{std::forward<Args>(args)...};
+        memcpy(componentPtr, &component, componentType.coldOffset);
+        memcpy(getColdPointer(componentType, componentID), 
+               reinterpret_cast<uint8_t*>(&component) + componentType.coldOffset, componentType.coldSize);
+    } else {
+        new (componentPtr) T{std::forward<Args>(args)...};
+    }
+}
+
+// Checks that the component can be added and makes room for it at the end of the pool,
+// null if it can't
+ECS::ComponentType *ECS::prepareAddComponent(EntityID entityId, ComponentTypeID typeID) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, nullptr);
 
     auto componentTypeIt = componentTypes.find(typeID);
-    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), nullptr);
 
     ComponentType& componentType = componentTypeIt->second;
 
     ECS_WARNING_IF(componentType.isSingular && componentType.size > 0, 
-                "Singular component already exists '" + componentType.name + "'", *this);
+                "Singular component already exists '" + componentType.name + "'", nullptr);
 
-    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), nullptr);
 
-    ECS_WARNING_IF((*entities).at(entityId.id).componentIDs.find(typeID) != (*entities).at(entityId.id).componentIDs.end(),
-                         ENTITY_ALREADY_CONTAINS_COMPONENT(componentType.name), *this);
+    if (!canAddComponent(entityId, typeID, componentType)) {
+        return nullptr;
+    }
 
     if (componentType.size >= componentType.capacity) {
-        refitComponentTypeStorage(componentType, componentType.growthFactor);
+        refitComponentTypeStorage(componentType, componentType.growthFactor, settings.numaAware);
     }
 
-    Component<T>* componentStorage = static_cast<Component<T>*>(componentType.storage);
-    new (&componentStorage[componentType.size]) Component<T>{T{std::forward<Args>(args)...}, entityId}; 
+    return &componentType;
+}
 
-    (*entities).at(entityId.id).componentIDs[typeID] = componentType.size;
-    componentType.size++;
+// The checks of prepareAddComponent that depend on the entity
+bool ECS::canAddComponent(EntityID entityId, ComponentTypeID typeID, ComponentType &componentType) {
+    ECS_WARNING_IF(entityId.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityId.id)), false);
 
-    if (addComponentSystems.find(typeID) != addComponentSystems.end()) {
-        addComponentSystems.at(typeID)(*this, entityId);
-    }
+    ECS_WARNING_IF((*entities)[entityId.id].componentIDs.find(typeID) != (*entities)[entityId.id].componentIDs.end(),
+                         ENTITY_ALREADY_CONTAINS_COMPONENT(componentType.name), false);
 
-    return *this;
+    return true;
 }
 
-void ECS::removeComponent(EntityID entityId, ComponentTypeID typeID){
-    ECS_ERROR_IF(restricted, ECS_IS_RESTRICTED);
+// Hands the component built at the end of the pool to the entity
+void ECS::commitAddComponent(EntityID entityId, ComponentTypeID typeID, ComponentType &componentType) {
+    placeComponent(entityId, typeID, componentType);
 
-    ECS_ERROR_IF(entityId.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityId.id)));
+    notifyAdded(typeID, entityId, getComponentPointer(componentType, (*entities)[entityId.id].componentIDs.at(typeID)));
+}
 
-    auto componentTypeIt = componentTypes.find(typeID);
+// commitAddComponent without the observers
+void ECS::placeComponent(EntityID entityId, ComponentTypeID typeID, ComponentType &componentType) {
+    copyBlobs(componentType, componentType.size);
+    setOwner(componentType, componentType.size, entityId);
+
+    (*entities).at(entityId.id).componentIDs[typeID] = componentType.size;
+    (*entities).at(entityId.id).signature.set(componentType.index);
+    componentType.size++;
+
+    addToGroup(entityId, componentType);
+
+    void *component = getComponentPointer(componentType, (*entities)[entityId.id].componentIDs.at(typeID));
+
+    indexComponent(componentType, entityId, component);
+}
+
+void ECS::addRawComponent(EntityID entityId, ComponentTypeID typeID, const void *component) {
+    ComponentType *componentType = prepareAddComponent(entityId, typeID);
+    if (componentType == nullptr) {
+        return;
+    }
+
+    void* componentPtr = getComponentPointer(*componentType, componentType->size);
+
+    if (componentType->coldSize > 0) {
+        memcpy(componentPtr, component, componentType->coldOffset);
+        memcpy(getColdPointer(*componentType, componentType->size), 
+               static_cast<const uint8_t*>(component) + componentType->coldOffset, componentType->coldSize);
+    } else {
+        memcpy(componentPtr, component, componentType->dataSize);
+    }
+
+    commitAddComponent(entityId, typeID, *componentType);
+}
+
+// The component is built now and added when the reserved entity is created
+template <typename T, typename... Args>
+ECS &ECS::addComponent(EntityReservation reservation, Args&&... args) {
+    ECS_REFUSE_IF(reservation.slot >= reservations->slots.size() || 
+                  reservations->slots[reservation.slot].guid.id != reservation.guid.id, ENTITY_RESERVATION_INVALID, *this);
+
+    auto addComponentFunc = [component = T{std::forward<Args>(args)...}](ECS &ecs, EntityID entityID) mutable {
+        ecs.addComponent<T>(entityID, std::move(component));
+    };
+    reservations->slots[reservation.slot].components.push_back(addComponentFunc);
+
+    return *this;
+}
+
+void ECS::removeComponent(EntityID entityId, ComponentTypeID typeID){
+    ECS_ERROR_IF(restricted, ECS_IS_RESTRICTED);
+
+    ECS_ERROR_IF(entityId.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityId.id)));
+
+    auto componentTypeIt = componentTypes.find(typeID);
     ECS_ERROR_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)));
 
     ComponentType& componentType = componentTypeIt->second;
@@ -586,7 +1611,7 @@ void ECS::removeComponent(EntityID entityId, ComponentTypeID typeID){
 
     ECS_ERROR_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name));
 
-    componentType.removeComponentFunc(entityId, *this);
+    eraseComponent(entityId, typeID);
 }
 
 template <typename T>
@@ -597,10 +1622,117 @@ ECS &ECS::removeComponent(EntityGUID entityID) {
 
 template <typename T>
 ECS &ECS::removeComponent(EntityID entityID) {
+    return eraseComponent(entityID, typeid(T).hash_code());
+}
+
+// Adds T to every entity of entityIDs. source is either the component they all get a copy of, or a 
+// generator called as source(EntityID) -> T. The type is checked and the pool grown once, and the 
+// observers are called after every component is in place.
+template <typename T, typename Source>
+ECS &ECS::addComponents(std::span<const EntityID> entityIDs, Source &&source) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+
+    ECS_WARNING_IF(componentType.isSingular && componentType.size + entityIDs.size() > 1, 
+                "Singular component already exists '" + componentType.name + "'", *this);
+
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+
+    if (componentType.size + entityIDs.size() > componentType.capacity) {
+        size_t newCapacity = std::max<size_t>(std::ceil(componentType.capacity * componentType.growthFactor), 
+                                              componentType.size + entityIDs.size());
+        resizeComponentTypeStorage(componentType, newCapacity, settings.numaAware);
+    }
+
+    // a plain vector rather than the frame arena, the observers may allocate from it
+    bool isObserved = observers.find(typeID) != observers.end();
+    std::vector<EntityGUID> added;
+    if (isObserved) {
+        added.reserve(entityIDs.size());
+    }
+
+    for (EntityID entityID : entityIDs) {
+        if (!canAddComponent(entityID, typeID, componentType)) continue;
+
+        if constexpr (std::is_invocable_v<Source&, EntityID> && !std::is_same_v<std::remove_cvref_t<Source>, T>) {
+            constructComponent<T>(componentType, componentType.size, source(entityID));
+        } else {
+            constructComponent<T>(componentType, componentType.size, source);
+        }
+        placeComponent(entityID, typeID, componentType);
+
+        if (isObserved) {
+            added.push_back((*entities)[entityID.id].guid);
+        }
+    }
+
+    for (EntityGUID guid : added) {
+        // found again, an earlier observer may have moved or removed it
+        auto entityIt = entitiesMap->find(guid);
+        if (entityIt == entitiesMap->end()) continue;
+
+        void *component = findObservedComponent(typeID, entityIt->second);
+        if (component == nullptr) continue;
+
+        notifyAdded(typeID, entityIt->second, component);
+    }
+
+    return *this;
+}
+
+// Removes T from every entity of entityIDs, the type is checked and the pool shrunk once. Each 
+// component is still in place while its observers run.
+template <typename T>
+ECS &ECS::removeComponents(std::span<const EntityID> entityIDs) {
     ComponentTypeID typeID = typeid(T).hash_code();
 
     ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+
+    for (EntityID entityID : entityIDs) {
+        if (!canRemoveComponent(entityID, typeID, componentType)) continue;
+
+        notifyRemoved(typeID, entityID, getComponentPointer(componentType, (*entities)[entityID.id].componentIDs.at(typeID)));
+
+        // checked again, the observers may have removed it already
+        if (findObservedComponent(typeID, entityID) == nullptr) continue;
+
+        detachComponent(entityID, typeID, componentType);
+    }
+
+    if (componentType.size < componentType.capacity / componentType.growthFactor) {
+        resizeComponentTypeStorage(componentType, std::max<size_t>(std::ceil(componentType.size * componentType.growthFactor), 1), 
+                                   settings.numaAware);
+    }
+
+    return *this;
+}
+
+// The checks of eraseComponent that depend on the entity
+bool ECS::canRemoveComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType) {
+    ECS_WARNING_IF(entityID.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), false);
+
+    ECS_WARNING_IF((*entities)[entityID.id].componentIDs.find(typeID) == (*entities)[entityID.id].componentIDs.end(), 
+                        ENTITY_DOESNT_CONTAIN_COMPONENT(componentType.name), false);
+
+    return true;
+}
+
+ECS &ECS::eraseComponent(EntityID entityID, ComponentTypeID typeID) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
     ECS_WARNING_IF(entityID.id >= entities->size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), *this);
 
     auto componentTypeIt = componentTypes.find(typeID);
@@ -616,29 +1748,231 @@ ECS &ECS::removeComponent(EntityID entityID) {
 
     ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
 
-    if (removeComponentSystems.find(typeID) != removeComponentSystems.end()) {
-        removeComponentSystems.at(typeID)(*this, entityID);
+    notifyRemoved(typeID, entityID, getComponentPointer(componentType, componentID));
+
+    // an observer may have removed it already
+    if (findObservedComponent(typeID, entityID) == nullptr) return *this;
+
+    detachComponent(entityID, typeID, componentType);
+
+    if (componentType.size < componentType.capacity / componentType.growthFactor) {
+        refitComponentTypeStorage(componentType, 1.0f / componentType.growthFactor, settings.numaAware);
     }
 
-    Component<T>* componentStorage = static_cast<Component<T>*>(componentType.storage);
+    return *this;
+}
+
+// eraseComponent without the checks, the observers and shrinking the pool
+void ECS::detachComponent(EntityID entityID, ComponentTypeID typeID, ComponentType &componentType) {
+    removeFromGroup(entityID, componentType);
+    ComponentID componentID = (*entities).at(entityID.id).componentIDs.at(typeID);
+
+    unindexComponent(componentType, entityID);
 
-    componentStorage->data.~T();
+    releaseBlobs(componentType, componentID);
+    if (componentType.destroyFunc != nullptr) {
+        componentType.destroyFunc(getComponentPointer(componentType, componentID));
+    }
 
-    EntityID lastEntityID = componentStorage[componentType.size - 1].owner;
+    EntityID lastEntityID = getOwner(componentType, componentType.size - 1);
     (*entities).at(lastEntityID.id).componentIDs.at(typeID) = componentID;
 
-    componentStorage[componentID] = componentStorage[componentType.size - 1];
+    copyComponent(componentType, componentType.size - 1, componentID);
     componentType.size--;
 
-    if (componentType.size < componentType.capacity / componentType.growthFactor) {
-        refitComponentTypeStorage(componentType, 1.0f / componentType.growthFactor);
+    (*entities).at(entityID.id).componentIDs.erase(typeID);
+    (*entities).at(entityID.id).signature.reset(componentType.index);
+}
+
+// Reorders the pool of T in place so that iteration follows `compare(const T&, const T&)`
+template <typename T, typename Compare>
+ECS &ECS::sortComponents(Compare compare) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+
+    ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), *this);
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    ECS_WARNING_IF(componentType.groupSignature.any(), COMPONENT_TYPE_IS_GROUPED(componentType.name), *this);
+
+    // order[i] is the component that ends up at index i
+    std::vector<ComponentID> order(componentType.size);
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
     }
 
-    (*entities).at(entityID.id).componentIDs.erase(typeID);
+    std::sort(order.begin(), order.end(), [&componentType, &compare](ComponentID a, ComponentID b) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            // split types are compared on whole copies
+            if (componentType.coldSize > 0) {
+                return compare(makeSplitComponent<T>(componentType, a).load(), makeSplitComponent<T>(componentType, b).load());
+            }
+        }
+        return compare(*static_cast<const T*>(getComponentPointer(componentType, a)), 
+                       *static_cast<const T*>(getComponentPointer(componentType, b)));
+    });
+
+    // Apply the permutation one cycle at a time, the element of i is swapped along until its spot is reached
+    for (size_t i = 0; i < order.size(); i++) {
+        size_t current = i;
+
+        while (order[current] != i) {
+            size_t next = order[current];
+            swapComponents(componentType, typeID, current, next);
+            order[current] = current;
+            current = next;
+        }
+
+        order[current] = current;
+    }
+
+    return *this;
+}
+
+// Reorders the pool of U so that entities which also have T come first, in the order of T's pool
+template <typename U, typename T>
+ECS &ECS::sortComponentsLike() {
+    ComponentTypeID typeID = typeid(U).hash_code();
+    ComponentTypeID leaderTypeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    auto leaderTypeIt = componentTypes.find(leaderTypeID);
+    ECS_WARNING_IF(leaderTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(leaderTypeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+    ComponentType& leaderType = leaderTypeIt->second;
+
+    ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), *this);
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    ECS_WARNING_IF(leaderType.isLocked, COMPONENT_TYPE_IS_LOCKED(leaderType.name), *this);
+    ECS_WARNING_IF(componentType.groupSignature.any(), COMPONENT_TYPE_IS_GROUPED(componentType.name), *this);
+
+    ComponentID next = 0;
+    for (size_t i = 0; i < leaderType.size; i++) {
+        Entity &entity = (*entities)[getOwner(leaderType, i).id];
+
+        if (!entity.signature.test(componentType.index)) continue;
+
+        swapComponents(componentType, typeID, next, entity.componentIDs.at(typeID));
+        next++;
+    }
+
+    return *this;
+}
+
+// Packs every entity that has all of Components into the front of each of their pools, in the
+// same order, so joins over the group become a parallel walk of [0, groupSize)
+template <typename... Components>
+ECS &ECS::group() {
+    std::vector<ComponentTypeID> typeIDs = {typeid(Components).hash_code()...};
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    ComponentSignature signature;
+    ComponentType *smallest = nullptr;
+
+    for (ComponentTypeID typeID : typeIDs) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+        ComponentType &componentType = componentTypeIt->second;
+        ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+        ECS_WARNING_IF(componentType.groupSignature.any(), COMPONENT_TYPE_IS_GROUPED(componentType.name), *this);
+
+        signature.set(componentType.index);
+
+        if (smallest == nullptr || componentType.size < smallest->size) {
+            smallest = &componentType;
+        }
+    }
+
+    for (ComponentTypeID typeID : typeIDs) {
+        ComponentType &componentType = componentTypes.at(typeID);
+        componentType.groupSignature = signature;
+        componentType.groupSize = 0;
+    }
+
+    groups.push_back({typeIDs, signature});
+
+    for (size_t i = 0; i < smallest->size; i++) {
+        EntityID entityID = getOwner(*smallest, i);
+        Entity &entity = (*entities)[entityID.id];
+
+        if ((entity.signature & signature) != signature) continue;
+
+        for (ComponentTypeID typeID : typeIDs) {
+            ComponentType &componentType = componentTypes.at(typeID);
+            swapComponents(componentType, typeID, componentType.groupSize, entity.componentIDs.at(typeID));
+            componentType.groupSize++;
+        }
+    }
 
     return *this;
 }
 
+void ECS::addToGroup(EntityID entityID, ComponentType &componentType) {
+    if (componentType.groupSignature.none()) return;
+
+    Entity &entity = (*entities)[entityID.id];
+    if ((entity.signature & componentType.groupSignature) != componentType.groupSignature) return;
+
+    for (Group &group : groups) {
+        if (group.signature != componentType.groupSignature) continue;
+
+        for (ComponentTypeID typeID : group.componentTypeIDs) {
+            ComponentType &groupType = componentTypes.at(typeID);
+            swapComponents(groupType, typeID, groupType.groupSize, entity.componentIDs.at(typeID));
+            groupType.groupSize++;
+        }
+    }
+}
+
+void ECS::removeFromGroup(EntityID entityID, ComponentType &componentType) {
+    if (componentType.groupSignature.none()) return;
+
+    Entity &entity = (*entities)[entityID.id];
+    if ((entity.signature & componentType.groupSignature) != componentType.groupSignature) return;
+
+    for (Group &group : groups) {
+        if (group.signature != componentType.groupSignature) continue;
+
+        for (ComponentTypeID typeID : group.componentTypeIDs) {
+            ComponentType &groupType = componentTypes.at(typeID);
+            groupType.groupSize--;
+            swapComponents(groupType, typeID, groupType.groupSize, entity.componentIDs.at(typeID));
+        }
+    }
+}
+
+// Components are relocated with memcpy elsewhere (see refitComponentTypeStorage), so swapping bytes is safe
+void ECS::swapComponents(ComponentType &componentType, ComponentTypeID typeID, ComponentID a, ComponentID b) {
+    if (a == b) return;
+
+    uint8_t* componentStorage = static_cast<uint8_t*>(componentType.storage);
+
+    std::swap_ranges(componentStorage + a * componentType.componentSize, 
+                     componentStorage + (a + 1) * componentType.componentSize,
+                     componentStorage + b * componentType.componentSize);
+
+    if (componentType.coldSize > 0) {
+        std::swap_ranges(static_cast<uint8_t*>(getColdPointer(componentType, a)), 
+                         static_cast<uint8_t*>(getColdPointer(componentType, a)) + componentType.coldSize,
+                         static_cast<uint8_t*>(getColdPointer(componentType, b)));
+    }
+
+    (*entities)[getOwner(componentType, a).id].componentIDs.at(typeID) = a;
+    (*entities)[getOwner(componentType, b).id].componentIDs.at(typeID) = b;
+}
+
 template<typename... Components>
 std::tuple<Components&...> ECS::getComponents(EntityID entityId) {
     return std::tuple<Components&...>{getComponent<Components>(entityId)...};
@@ -654,10 +1988,11 @@ template <typename T> T &ECS::getComponent(){
 
     ECS_ERROR_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name));
     ECS_ERROR_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name));
+    ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), loadSplitCopy<T>(componentType, 0));
 
-    Component<T>* componentPtrCasted = static_cast<Component<T>*>(componentType.storage);
+    markIndexesChanged(componentType); // the whole pool is reachable from the first component
 
-    return componentPtrCasted->data;
+    return *static_cast<T*>(componentType.storage);
 }
 
 template <typename T>
@@ -669,11 +2004,13 @@ template <typename T>
 T &ECS::getComponent(EntityID entityId) {
     ComponentTypeID typeID = typeid(T).hash_code();
 
-    void* componentPtr = getComponent(entityId, typeID);
+    void *component = getComponent(entityId, typeID);
 
-    Component<T>* componentPtrCasted = static_cast<Component<T>*>(componentPtr);
+    const ComponentType &componentType = componentTypes.at(typeID);
+    ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), 
+                  loadSplitCopy<T>(componentType, (*entities)[entityId.id].componentIDs.at(typeID)));
 
-    return componentPtrCasted->data;
+    return *static_cast<T*>(component);
 }
 
 void* ECS::getComponent(EntityID entityId, ComponentTypeID typeID){
@@ -692,6 +2029,8 @@ void* ECS::getComponent(EntityID entityId, ComponentTypeID typeID){
     ECS_ERROR_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name));
     ECS_ERROR_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name));
 
+    markIndexChanged(componentType, entityId);
+
     char* componentStorage = static_cast<char*>(componentType.storage);
     char* componentPtr = componentStorage + (componentID * componentType.componentSize);
 
@@ -718,9 +2057,82 @@ template <typename T> const T &ECS::readComponent(EntityID entityId) const{
     ComponentID componentID = componentIndexIt->second;
 
     ECS_ERROR_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name));
+    ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), loadSplitCopy<T>(componentType, componentID));
+
+    return *static_cast<const T*>(getComponentPointer(componentType, componentID));
+}
+
+template <typename T> SplitComponent<T> ECS::getSplitComponent(EntityGUID entityId) {
+    return getSplitComponent<T>(getEntityID(entityId));
+}
+
+// Works for every T, also the ones that aren't split
+template <typename T> SplitComponent<T> ECS::getSplitComponent(EntityID entityId) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    getComponent(entityId, typeID); // same checks as getComponent<T>
+
+    return makeSplitComponent<T>(componentTypes.at(typeID), (*entities)[entityId.id].componentIDs.at(typeID));
+}
+
+template <typename T>
+SplitComponent<T> ECS::makeSplitComponent(const ComponentType &componentType, ComponentID componentID) {
+    SplitComponent<T> component;
+    component.hot = static_cast<uint8_t*>(getComponentPointer(componentType, componentID));
+
+    if (componentType.coldSize > 0) {
+        component.cold = static_cast<uint8_t*>(getColdPointer(componentType, componentID));
+        component.coldOffset = componentType.coldOffset;
+    } else {
+        component.coldOffset = sizeof(T);
+    }
+
+    return component;
+}
+
+// What typed access to a split type gets instead of the component: a per-thread copy of it, 
+// valid until the next copy on that thread. Writes to it are lost.
+template <typename T>
+T &ECS::loadSplitCopy(const ComponentType &componentType, ComponentID componentID) {
+    thread_local T copy;
+    copy = componentID < componentType.size ? makeSplitComponent<T>(componentType, componentID).load() : T{};
+    return copy;
+}
+
+template <typename T>
+template <typename M>
+M &SplitComponent<T>::get(M T::*member) const {
+    size_t offset = ECS::getMemberOffset(member);
+
+    if (offset < coldOffset) {
+        return *reinterpret_cast<M*>(hot + offset);
+    }
+    return *reinterpret_cast<M*>(cold + offset - coldOffset);
+}
+
+template <typename T>
+T SplitComponent<T>::load() const {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        if (cold != nullptr) {
+            T component;
+            memcpy(&component, hot, coldOffset);
+            memcpy(reinterpret_cast<uint8_t*>(&component) + coldOffset, cold, sizeof(T) - coldOffset);
+            return component;
+        }
+    }
+    return *reinterpret_cast<const T*>(hot);
+}
 
-    const Component<T>* componentStorage = static_cast<const Component<T>*>(componentType.storage);
-    return componentStorage[componentID].data;
+template <typename T>
+void SplitComponent<T>::store(const T &component) const {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        if (cold != nullptr) {
+            memcpy(hot, &component, coldOffset);
+            memcpy(cold, reinterpret_cast<const uint8_t*>(&component) + coldOffset, sizeof(T) - coldOffset);
+            return;
+        }
+    }
+    *reinterpret_cast<T*>(hot) = component;
 }
 
 template <typename T> ECS &ECS::setReadOnly(){
@@ -728,6 +2140,13 @@ template <typename T> ECS &ECS::setReadOnly(){
 
     ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
+    Resource *resource = findResource(typeID);
+    if(resource != nullptr){
+        ECS_WARNING_IF(resource->isLocked, RESOURCE_IS_LOCKED(resource->name), *this);
+        resource->isReadOnly = true;
+        return *this;
+    }
+
     auto componentTypeIt = componentTypes.find(typeID);
     ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
 
@@ -744,6 +2163,13 @@ template <typename T> ECS &ECS::setReadWrite(){
 
     ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
+    Resource *resource = findResource(typeID);
+    if(resource != nullptr){
+        ECS_WARNING_IF(resource->isLocked, RESOURCE_IS_LOCKED(resource->name), *this);
+        resource->isReadOnly = false;
+        return *this;
+    }
+
     auto componentTypeIt = componentTypes.find(typeID);
     ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
 
@@ -773,43 +2199,199 @@ template <typename T> ECS &ECS::setSingular(){
     return *this;
 }
 
-template <typename T> std::string ECS::toString(T &t, int arraySize){
-    return toString<T>((void*)&t, *this, arraySize);
-}
+// Writes keep going to the pool while swapBuffers() publishes copies of it for other threads.
+// With two copies a swap is skipped while a reader still holds the older one, with three 
+// (triple buffering) a single reader never holds up a swap.
+template <typename T> 
+ECS &ECS::setBuffered(size_t bufferCount) {
+    static_assert(std::is_trivially_copyable_v<T>, "Buffered components are copied with memcpy");
 
-template <typename U, typename T> std::string ECS::toString(T &t, std::string memberName){
-    MemberMeta member = getMemberMeta<T>(memberName);
-    void* memberPtr = reinterpret_cast<uint8_t*>(&t) + member.offset;
-    return toString<U>(memberPtr, *this, member.arraySize);
-}
+    ComponentTypeID typeID = typeid(T).hash_code();
 
-template <typename T> void ECS::fromString(T &t, std::string str, int arraySize){
-    fromString<T>((void*)&t, str, *this, arraySize);
-}
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
 
-template <typename T> ECS &ECS::addComponentType(size_t reserve){
-    return addComponentType<T>(typeid(T).name(), reserve);
+    ComponentType &componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), *this);
+
+    if (componentType.bufferedStorage != nullptr) {
+        for (ComponentBuffer &buffer : componentType.bufferedStorage->buffers) {
+            ECS_REFUSE_IF(buffer.readers.load() > 0, "Snapshots of '" + componentType.name + "' are still held", *this);
+        }
+    }
+
+    deleteBufferedStorage(componentType);
+
+    componentType.bufferedStorage = new BufferedStorage();
+    componentType.bufferedStorage->buffers = std::vector<ComponentBuffer>(std::max<size_t>(bufferCount, 2));
+
+    return *this;
 }
 
-template <typename T>
-ECS &ECS::addComponentType(std::string name, size_t reserve) {
+// Never blocks. Empty until the first swapBuffers().
+template <typename T> 
+ComponentSnapshot<T> ECS::snapshot() {
     ComponentTypeID typeID = typeid(T).hash_code();
+    ComponentSnapshot<T> snapshot;
 
-    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), snapshot);
 
-    ECS_WARNING_IF(componentTypes.find(typeID) != componentTypes.end(), COMPONENT_TYPE_ALREADY_EXISTS(std::to_string(typeID)), *this);
+    ComponentType &componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.bufferedStorage == nullptr, COMPONENT_TYPE_NOT_BUFFERED(componentType.name), snapshot);
 
-    void* storage = new uint8_t[reserve * sizeof(Component<T>)];
+    BufferedStorage &bufferedStorage = *componentType.bufferedStorage;
 
-    componentTypes[typeID] = {
-        .storage = storage,
+    // pin the published buffer, and check it wasn't replaced before the pin was seen
+    ComponentBuffer *buffer = bufferedStorage.published.load();
+    while (buffer != nullptr) {
+        buffer->readers.fetch_add(1);
+        
+        ComponentBuffer *published = bufferedStorage.published.load();
+        if (published == buffer) break;
+        
+        buffer->readers.fetch_sub(1);
+        buffer = published;
+    }
+
+    if (buffer == nullptr) return snapshot;
+
+    snapshot.storage = static_cast<const uint8_t*>(buffer->storage);
+    snapshot.count = buffer->size;
+    snapshot.componentSize = componentType.componentSize;
+    snapshot.ownerOffset = componentType.ownerOffset;
+    snapshot.readers = &buffer->readers;
+
+    return snapshot;
+}
+
+ECS &ECS::swapBuffers() {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    for (auto &[typeID, componentType] : componentTypes) {
+        if (componentType.bufferedStorage != nullptr) {
+            publishBuffer(componentType);
+        }
+    }
+
+    return *this;
+}
+
+// Copies the pool into a buffer nobody is reading and publishes it with a single pointer store
+void ECS::publishBuffer(ComponentType &componentType) {
+    BufferedStorage &bufferedStorage = *componentType.bufferedStorage;
+    ComponentBuffer *published = bufferedStorage.published.load();
+
+    ComponentBuffer *buffer = nullptr;
+    for (ComponentBuffer &candidate : bufferedStorage.buffers) {
+        if (&candidate != published && candidate.readers.load() == 0) {
+            buffer = &candidate;
+            break;
+        }
+    }
+
+    if (buffer == nullptr) return; // every other copy is still being read, keep the published one
+
+    size_t bytes = componentType.size * componentType.componentSize;
+    if (componentType.size > buffer->capacity) {
+        delete[] static_cast<uint8_t*>(buffer->storage);
+        buffer->storage = new uint8_t[bytes];
+        buffer->capacity = componentType.size;
+    }
+
+    memcpy(buffer->storage, componentType.storage, bytes);
+    buffer->size = componentType.size;
+
+    bufferedStorage.published.store(buffer);
+}
+
+void ECS::deleteBufferedStorage(ComponentType &componentType) {
+    if (componentType.bufferedStorage == nullptr) return;
+
+    for (ComponentBuffer &buffer : componentType.bufferedStorage->buffers) {
+        delete[] static_cast<uint8_t*>(buffer.storage);
+    }
+
+    delete componentType.bufferedStorage;
+    componentType.bufferedStorage = nullptr;
+}
+
+template <typename T>
+ComponentSnapshot<T>::ComponentSnapshot(ComponentSnapshot &&other) noexcept {
+    *this = std::move(other);
+}
+
+template <typename T>
+ComponentSnapshot<T> &ComponentSnapshot<T>::operator=(ComponentSnapshot &&other) noexcept {
+    if (this != &other) {
+        if (readers != nullptr) readers->fetch_sub(1);
+
+        storage = other.storage;
+        count = other.count;
+        componentSize = other.componentSize;
+        ownerOffset = other.ownerOffset;
+        readers = other.readers;
+        other.readers = nullptr;
+    }
+    return *this;
+}
+
+template <typename T>
+ComponentSnapshot<T>::~ComponentSnapshot() {
+    if (readers != nullptr) readers->fetch_sub(1);
+}
+
+template <typename T> std::string ECS::toString(T &t, int arraySize){
+    return toString<T>((void*)&t, *this, arraySize);
+}
+
+template <typename U, typename T> std::string ECS::toString(T &t, std::string memberName){
+    MemberMeta member = getMemberMeta<T>(memberName);
+    void* memberPtr = reinterpret_cast<uint8_t*>(&t) + member.offset;
+    return toString<U>(memberPtr, *this, member.arraySize);
+}
+
+template <typename T> void ECS::fromString(T &t, std::string str, int arraySize){
+    fromString<T>((void*)&t, str, *this, arraySize);
+}
+
+
+template <typename T> ECS &ECS::addComponentType(size_t reserve){
+    return addComponentType<T>(typeid(T).name(), reserve);
+}
+
+template <typename T>
+ECS &ECS::addComponentType(std::string name, size_t reserve) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    ECS_WARNING_IF(componentTypes.find(typeID) != componentTypes.end(), COMPONENT_TYPE_ALREADY_EXISTS(std::to_string(typeID)), *this);
+
+    ECS_REFUSE_IF(componentTypeIndices.all(), TOO_MANY_COMPONENT_TYPES, *this);
+
+    size_t index = 0;
+    while (componentTypeIndices.test(index)) {
+        index++;
+    }
+    componentTypeIndices.set(index);
+
+    void* storage = new uint8_t[reserve * sizeof(Component<T>)];
+
+    componentTypes[typeID] = {
+        .storage = storage,
         .componentSize = sizeof(Component<T>),
+        .ownerOffset = reinterpret_cast<size_t>(&(reinterpret_cast<Component<T>*>(0)->owner)),
         .size = 0,
         .capacity = reserve,
+        .index = index,
+        .accessLock = new AccessLock(),
+        .dataSize = sizeof(T),
         .addComponentFunc = addComponent<T>,
-        .removeComponentTypeFunc = removeComponentType_<T>,
-        .removeComponentFunc = removeComponent_<T>,
+        .destroyFunc = destroyComponent<T>,
         .toString = toString<T>,
         .fromString = fromString<T>,
         .name = name,
@@ -817,26 +2399,147 @@ ECS &ECS::addComponentType(std::string name, size_t reserve) {
 
     componentTypeNames[name] = typeID;
 
+    if constexpr (has_member_descriptors<T>::value) {
+        std::apply([this](const auto&... descriptors) {
+            (addMemberMeta(descriptors.pointer, descriptors.name, descriptors.arraySize), ...);
+        }, T::members);
+    }
+
     return *this;
 }
 
+// For components defined by data (mods, tools) rather than by a C++ type. The pool holds `size`
+// bytes per component, which are copied in by addComponent(EntityID, ComponentTypeID, void*)
+// and read through getComponent or forEachDynamic. The id is derived from the name, so it is 
+// the same in every run.
+ComponentTypeID ECS::addComponentType(std::string name, size_t size, size_t alignment, std::vector<MemberLayout> members, size_t reserve) {
+    ComponentTypeID typeID = std::hash<std::string>{}(name);
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, 0);
+
+    ECS_WARNING_IF(componentTypes.find(typeID) != componentTypes.end() || componentTypeNames.find(name) != componentTypeNames.end(), 
+                   COMPONENT_TYPE_ALREADY_EXISTS(name), 0);
+
+    ECS_WARNING_IF(alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > alignof(std::max_align_t), 
+                   ALIGNMENT_NOT_SUPPORTED(std::to_string(alignment)), 0);
+
+    ECS_REFUSE_IF(componentTypeIndices.all(), TOO_MANY_COMPONENT_TYPES, 0);
+
+    size_t index = 0;
+    while (componentTypeIndices.test(index)) {
+        index++;
+    }
+    componentTypeIndices.set(index);
+
+    // laid out like Component<T>: the bytes, then the owner, padded to the stricter alignment
+    size_t ownerOffset = (size + alignof(EntityID) - 1) / alignof(EntityID) * alignof(EntityID);
+    size_t strideAlignment = std::max(alignment, alignof(EntityID));
+    size_t componentSize = (ownerOffset + sizeof(EntityID) + strideAlignment - 1) / strideAlignment * strideAlignment;
+
+    ComponentType componentType{
+        .storage = new uint8_t[reserve * componentSize],
+        .size = 0,
+        .componentSize = componentSize,
+        .ownerOffset = ownerOffset,
+        .capacity = reserve,
+        .index = index,
+        .name = name,
+        .accessLock = new AccessLock(),
+        .dataSize = size,
+    };
+
+    for (MemberLayout &member : members) {
+        componentType.hasBlobs = componentType.hasBlobs || member.meta.isBlob;
+        componentType.members.insert({member.name, member.meta});
+    }
+
+    componentTypes[typeID] = componentType;
+    componentTypeNames[name] = typeID;
+
+    return typeID;
+}
+
 template <typename T>
 ECS &ECS::removeComponentType() {
-    ComponentTypeID typeID = typeid(T).hash_code();
+    return removeComponentType(typeid(T).hash_code());
+}
 
+ECS &ECS::removeComponentType(ComponentTypeID typeID) {
     ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
     auto componentTypeIt = componentTypes.find(typeID);
     ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
 
     ComponentType& componentType = componentTypeIt->second;
+
+    for (ComponentID componentID = 0; componentID < componentType.size; componentID++) {
+        releaseBlobs(componentType, componentID);
+
+        if (componentType.destroyFunc != nullptr) {
+            componentType.destroyFunc(getComponentPointer(componentType, componentID));
+        }
+    }
+
     delete[] static_cast<uint8_t*>(componentType.storage);
     componentType.storage = nullptr;
 
+    delete[] static_cast<uint8_t*>(componentType.coldStorage);
+    componentType.coldStorage = nullptr;
+
+    delete componentType.spatialIndex;
+    componentType.spatialIndex = nullptr;
+
+    delete componentType.indexChanges;
+    componentType.indexChanges = nullptr;
+
+    delete componentType.accessLock;
+    componentType.accessLock = nullptr;
+
+    deleteBufferedStorage(componentType);
+
+    for (auto &memberIndex : componentType.memberIndexes) {
+        memberIndex.second->destroy(*memberIndex.second);
+        delete memberIndex.second;
+    }
+    componentType.memberIndexes.clear();
+
+    for (Entity &entity : *entities) {
+        entity.signature.reset(componentType.index);
+        entity.componentIDs.erase(typeID);
+    }
+    componentTypeIndices.reset(componentType.index);
+
+    if (componentType.groupSignature.any()) {
+        for (size_t i = 0; i < groups.size(); i++) {
+            if (groups[i].signature != componentType.groupSignature) continue;
+
+            for (ComponentTypeID groupTypeID : groups[i].componentTypeIDs) {
+                auto groupTypeIt = componentTypes.find(groupTypeID);
+                if (groupTypeIt == componentTypes.end()) continue;
+
+                groupTypeIt->second.groupSignature.reset();
+                groupTypeIt->second.groupSize = 0;
+            }
+
+            groups.erase(groups.begin() + i);
+            break;
+        }
+    }
+
+    auto nameIt = componentTypeNames.find(componentType.name);
+    if (nameIt != componentTypeNames.end() && nameIt->second == typeID) {
+        componentTypeNames.erase(nameIt);
+    }
+
     componentTypes.erase(typeID);
     return *this;
 }
 
+template <typename T>
+void ECS::destroyComponent(void *component) {
+    static_cast<T*>(component)->~T();
+}
+
 template <typename T> std::string ECS::getComponentTypeName(){
     ComponentTypeID typeID = typeid(T).hash_code();
 
@@ -860,6 +2563,27 @@ template <typename T> ComponentTypeID ECS::getComponentTypeID(){
     return typeID;
 }
 
+ComponentTypeID ECS::getComponentTypeID(std::string name){
+    auto nameIt = componentTypeNames.find(name);
+    ECS_WARNING_IF(nameIt == componentTypeNames.end(), COMPONENT_TYPE_DOESNT_EXIST(name), 0);
+
+    return nameIt->second;
+}
+
+template <typename... Components> ComponentSignature ECS::getSignature(){
+    ComponentSignature signature;
+    std::vector<ComponentTypeID> typeIDs = {typeid(Components).hash_code()...};
+
+    for (ComponentTypeID typeID : typeIDs) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), ComponentSignature{});
+
+        signature.set(componentTypeIt->second.index);
+    }
+
+    return signature;
+}
+
 template <typename T, typename MemberType>
 ECS &ECS::addMemberMeta(MemberType T::*memberPtr, std::string name, int arraySize_, 
     ToStringFunc toString_, FromStringFunc fromString_) {
@@ -872,28 +2596,61 @@ ECS &ECS::addMemberMeta(MemberType T::*memberPtr, std::string name, int arraySiz
 
     ComponentType& componentType = componentTypeIt->second;
 
+    MemberMeta member = makeMemberMeta<MemberType>(getMemberOffset(memberPtr), arraySize_, toString_, fromString_);
+
+    componentType.hasBlobs = componentType.hasBlobs || member.isBlob;
+    componentType.members.insert({name, member});
+
+    return *this;
+}
+
+// Measured on storage that is never constructed, rather than through a null T*
+template <typename T, typename M>
+size_t ECS::getMemberOffset(M T::*memberPtr) {
+    union Storage {
+        char placeholder;
+        T object;
+
+        Storage() {}
+        ~Storage() {}
+    };
+    static Storage storage;
+
+    return reinterpret_cast<const char*>(&(storage.object.*memberPtr)) - reinterpret_cast<const char*>(&storage.object);
+}
+
+// The metadata of a member of type M, also used to describe the members of runtime component types
+template <typename M>
+MemberMeta ECS::makeMemberMeta(size_t offset, int arraySize_, ToStringFunc toString_, FromStringFunc fromString_) {
     MemberMeta member{
-        .offset = reinterpret_cast<size_t>(&(reinterpret_cast<T*>(0)->*memberPtr)),
-        .size = sizeof(MemberType),
-        .isPointer = std::is_pointer<MemberType>::value,
+        .offset = offset,
+        .size = sizeof(M),
+        .isPointer = std::is_pointer<M>::value,
         .arraySize = arraySize_,
+        .isBlob = is_blob_array<M>::value,
     };
 
     if(fromString_ == nullptr){
-        member.fromString = fromString<MemberType>;
+        member.fromString = fromString<M>;
     }else{
         member.fromString = fromString_;
     }
 
     if(toString_ == nullptr){
-        member.toString = toString<MemberType>;
+        member.toString = toString<M>;
     }else{
         member.toString = toString_;
     }
 
-    componentType.members.insert({name, member});
+    if constexpr (std::is_arithmetic_v<M>) {
+        member.toNumber = toNumber<M>;
+    }
 
-    return *this;
+    if constexpr (is_hashable<M>::value || is_less_comparable<M>::value) {
+        member.createIndex = createMemberIndex<M>;
+    }
+
+    return member;
 }
 
 MemberMeta ECS::getMemberMeta(std::string name, ComponentTypeID typeID){
@@ -912,19 +2669,80 @@ template <typename T> MemberMeta ECS::getMemberMeta(std::string name){
     return getMemberMeta(name, typeid(T).hash_code());
 }
 
+// Keeps the listed members in the pool and moves the rest of T to a side pool, so loops over T 
+// only pull the hot bytes through the cache. The hot members have to come first in T. There is
+// no whole T left to refer to, so forEach, queries and observers refuse split types and 
+// getComponent and readComponent only hand out a copy, they are reached through 
+// getSplitComponent, forEachSplit and getMember instead.
 template <typename T>
-ECS &ECS::forEach(std::function<void(T&)> func, size_t threadCount) {
-    auto wrappedFunc = [func](EntityID, T& component) {
-        func(component);
-    };
+ECS &ECS::setHotMembers(std::vector<std::string> hotMembers) {
+    ComponentTypeID typeID = typeid(T).hash_code();
 
-    forEach<T>(wrappedFunc, threadCount);
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType &componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    auto observersIt = observers.find(typeID);
+    bool isObserved = observersIt != observers.end() && 
+                      (!observersIt->second.onAdd.empty() || !observersIt->second.onRemove.empty());
+
+    ECS_REFUSE_IF(!std::is_trivially_copyable_v<T> || componentType.size > 0 || componentType.coldSize > 0 ||
+                  componentType.spatialIndex != nullptr || !componentType.memberIndexes.empty() || 
+                  componentType.bufferedStorage != nullptr || isObserved, COMPONENT_TYPE_CANT_BE_SPLIT(componentType.name), *this);
+
+    // the hot part runs up to the end of the last hot member
+    size_t coldOffset = 0;
+    for (const std::string &hotMember : hotMembers) {
+        auto memberIt = componentType.members.find(hotMember);
+        ECS_REFUSE_IF(memberIt == componentType.members.end(), MEMBER_DOESNT_EXIST(hotMember), *this);
+
+        coldOffset = std::max(coldOffset, memberIt->second.offset + memberIt->second.size);
+    }
+
+    for (auto &[name, member] : componentType.members) {
+        if (std::find(hotMembers.begin(), hotMembers.end(), name) != hotMembers.end()) continue;
+
+        ECS_REFUSE_IF(member.offset < coldOffset, "Cold member '" + name + "' sits between hot members of '" + 
+                      componentType.name + "', declare the hot members first", *this);
+    }
+
+    if (coldOffset >= sizeof(T)) return *this; // nothing left to move out
+
+    componentType.coldOffset = coldOffset;
+    componentType.coldSize = sizeof(T) - coldOffset;
+    componentType.ownerOffset = (coldOffset + alignof(EntityID) - 1) / alignof(EntityID) * alignof(EntityID);
+
+    size_t alignment = alignof(Component<T>);
+    componentType.componentSize = (componentType.ownerOffset + sizeof(EntityID) + alignment - 1) / alignment * alignment;
+
+    delete[] static_cast<uint8_t*>(componentType.storage);
+    componentType.storage = new uint8_t[componentType.capacity * componentType.componentSize];
+    componentType.coldStorage = new uint8_t[componentType.capacity * componentType.coldSize];
 
     return *this;
 }
 
-template <typename T>
-ECS &ECS::forEach(std::function<void(EntityID, T&)> func, size_t threadCount) {
+template <typename M, typename T>
+M &ECS::getMember(EntityID entityID, std::string memberName) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    getComponent(entityID, typeID); // same checks as getComponent<T>
+
+    ComponentType &componentType = componentTypes.at(typeID);
+
+    auto memberIt = componentType.members.find(memberName);
+    ECS_ERROR_IF(memberIt == componentType.members.end(), MEMBER_DOESNT_EXIST(memberName));
+
+    ComponentID componentID = (*entities)[entityID.id].componentIDs.at(typeID);
+    return *static_cast<M*>(getMemberPointer(componentType, componentID, memberIt->second));
+}
+
+// Loops over T as func(SplitComponent<T>) or func(EntityID, SplitComponent<T>), split or not
+template <typename T, typename Func>
+ECS &ECS::forEachSplit(Func func, size_t threadCount) {
     ComponentTypeID typeID = typeid(T).hash_code();
 
     auto componentTypeIt = componentTypes.find(typeID);
@@ -935,15 +2753,23 @@ ECS &ECS::forEach(std::function<void(EntityID, T&)> func, size_t threadCount) {
     ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), *this);
     ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
 
-    Component<T>* componentStorage = static_cast<Component<T>*>(componentType.storage);
-    size_t totalSize = componentType.size;
+    markIndexesChanged(componentType);
+
+    auto runChunk = [&componentType, &func](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            if constexpr (std::is_invocable_v<Func&, EntityID, SplitComponent<T>>) {
+                func(getOwner(componentType, i), makeSplitComponent<T>(componentType, i));
+            } else {
+                func(makeSplitComponent<T>(componentType, i));
+            }
+        }
+    };
 
+    size_t totalSize = componentType.size;
     threadCount = std::min(threadCount, totalSize);
 
     if(threadCount <= 1){
-        for (size_t i = 0; i < componentType.size; i++) {
-            func(componentStorage[i].owner, componentStorage[i].data);
-        }
+        runChunk(0, totalSize);
 
         return *this;
     }
@@ -953,21 +2779,21 @@ ECS &ECS::forEach(std::function<void(EntityID, T&)> func, size_t threadCount) {
     std::vector<std::thread> threads;
     size_t chunkSize = totalSize / threadCount;
     size_t remainder = totalSize % threadCount;
+    size_t capacity = componentType.capacity;
 
     size_t start = 0;
     for (size_t i = 0; i < threadCount; i++) {
         size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
 
-        threads.emplace_back([=]() {
-            for (size_t j = start; j < end; j++) {
-                func(componentStorage[j].owner, componentStorage[j].data);
-            }
+        threads.emplace_back([this, &runChunk, capacity, start, end]() {
+            if (settings.numaAware) bindWorkerToNode(start, end, capacity);
+
+            runChunk(start, end);
         });
 
         start = end;
     }
 
-    // Join all threads
     for (auto& thread : threads) {
         thread.join();
     }
@@ -977,367 +2803,2289 @@ ECS &ECS::forEach(std::function<void(EntityID, T&)> func, size_t threadCount) {
     return *this;
 }
 
-template <typename Component1, typename Component2>
-ECS &ECS::forEach(std::function<void(Component1&, Component2&)> func, size_t threadCount) {
-    auto wrappedFunc = [func](EntityID, Component1& component1, Component2& component2) {
-        func(component1, component2);
-    };
+template <typename T, typename... Args> 
+ECS &ECS::insertResource(Args&&... args) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
-    forEach<Component1,Component2>(wrappedFunc, threadCount);
+    size_t index = getResourceIndex<T>();
+    if (index >= resources.size()) {
+        resources.resize(index + 1);
+    }
+
+    Resource &resource = resources[index];
+    ECS_WARNING_IF(resource.isLocked, RESOURCE_IS_LOCKED(resource.name), *this);
+
+    if (resource.data != nullptr) {
+        resource.destroyFunc(resource.data);
+    }
+
+    resource.data = new T(std::forward<Args>(args)...);
+    resource.typeID = typeid(T).hash_code();
+    resource.name = typeid(T).name();
+    resource.destroyFunc = destroyResource<T>;
+    resource.size = sizeof(T);
+
+    return *this;
+}
+
+template <typename T> 
+ECS &ECS::removeResource() {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(!hasResource<T>(), RESOURCE_DOESNT_EXIST(std::string(typeid(T).name())), *this);
+
+    Resource &resource = resources[getResourceIndex<T>()];
+    ECS_WARNING_IF(resource.isLocked, RESOURCE_IS_LOCKED(resource.name), *this);
+
+    resource.destroyFunc(resource.data);
+    resource = Resource{};
+
+    return *this;
+}
+
+template <typename T> 
+T &ECS::resource() {
+    size_t index = getResourceIndex<T>();
+    ECS_ERROR_IF(index >= resources.size() || resources[index].data == nullptr, RESOURCE_DOESNT_EXIST(std::string(typeid(T).name())));
+
+    Resource &resource = resources[index];
+    ECS_ERROR_IF(resource.isReadOnly, RESOURCE_IS_READ_ONLY(resource.name));
+    ECS_ERROR_IF(resource.isLocked, RESOURCE_IS_LOCKED(resource.name));
+
+    return *static_cast<T*>(resource.data);
+}
+
+template <typename T> 
+const T &ECS::readResource() const {
+    size_t index = getResourceIndex<T>();
+    ECS_ERROR_IF(index >= resources.size() || resources[index].data == nullptr, RESOURCE_DOESNT_EXIST(std::string(typeid(T).name())));
+
+    const Resource &resource = resources[index];
+    ECS_ERROR_IF(resource.isLocked, RESOURCE_IS_LOCKED(resource.name));
+
+    return *static_cast<const T*>(resource.data);
+}
+
+template <typename T> 
+bool ECS::hasResource() const {
+    size_t index = getResourceIndex<T>();
+    return index < resources.size() && resources[index].data != nullptr;
+}
+
+// Each resource type gets a process-wide slot the first time it is used, so lookups are a single index
+template <typename T> 
+size_t ECS::getResourceIndex() {
+    static const size_t index = resourceCount++;
+    return index;
+}
+
+template <typename T> 
+void ECS::destroyResource(void *data) {
+    delete static_cast<T*>(data);
+}
+
+ECS::Resource *ECS::findResource(ComponentTypeID typeID) {
+    for (auto &resource : resources) {
+        if (resource.data != nullptr && resource.typeID == typeID) {
+            return &resource;
+        }
+    }
+
+    return nullptr;
+}
+
+// Events can be sent from any system. Inside a running system batch they are published at the
+// end of the stage, so every reader in a stage sees the same events. Events live for two ticks,
+// call updateEvents() once per tick.
+template <typename E> 
+ECS &ECS::addEventType(size_t reserve) {
+    static_assert(std::is_trivially_copyable_v<E>, "Events are moved with memcpy");
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(getEventChannel<E>() != nullptr, EVENT_TYPE_ALREADY_EXISTS(std::string(typeid(E).name())), *this);
+
+    size_t index = getEventIndex<E>();
+    if (index >= eventChannels.size()) {
+        eventChannels.resize(index + 1, nullptr);
+    }
+
+    EventChannel *channel = new EventChannel();
+    channel->eventSize = sizeof(E);
+    channel->name = typeid(E).name();
+    channel->destroyFunc = destroyEvents<E>;
+    reserveEventBuffer(channel->current, sizeof(E), reserve);
+    reserveEventBuffer(channel->previous, sizeof(E), reserve);
+
+    eventChannels[index] = channel;
 
     return *this;
 }
 
-template <typename Component1, typename Component2>
-ECS &ECS::forEach(std::function<void(EntityID, Component1&, Component2&)> func, size_t threadCount) {
-    ComponentTypeID typeID1 = typeid(Component1).hash_code();
+template <typename E, typename... Args> 
+ECS &ECS::send(Args&&... args) {
+    static_assert(std::is_trivially_copyable_v<E>, "Events are moved with memcpy");
+
+    EventChannel *channel = getEventChannel<E>();
+    ECS_WARNING_IF(channel == nullptr, EVENT_TYPE_DOESNT_EXIST(std::string(typeid(E).name())), *this);
+
+    EventBuffer &buffer = channel->current;
+
+    if (!restricted) {
+        // no other senders, so the buffer can grow and the event is published straight away, 
+        // after the events claimed by workers since the last sync point
+        buffer.size = std::min(channel->reserved.load(std::memory_order_relaxed), buffer.capacity);
+
+        if (buffer.size == buffer.capacity) {
+            reserveEventBuffer(buffer, sizeof(E), buffer.capacity * 2 + 1);
+        }
+
+        new (static_cast<E*>(buffer.storage) + buffer.size) E{std::forward<Args>(args)...};
+        buffer.size++;
+        channel->reserved.store(buffer.size, std::memory_order_relaxed);
+
+        return *this;
+    }
+
+    size_t slot = channel->reserved.fetch_add(1, std::memory_order_relaxed);
+    ECS_REFUSE_IF(slot >= buffer.capacity, EVENT_CHANNEL_IS_FULL(channel->name), *this);
+
+    new (static_cast<E*>(buffer.storage) + slot) E{std::forward<Args>(args)...};
+
+    return *this;
+}
+
+template <typename E> 
+ECS &ECS::read(EventCursor &cursor, std::function<void(const E&)> func) {
+    EventChannel *channel = getEventChannel<E>();
+    ECS_WARNING_IF(channel == nullptr, EVENT_TYPE_DOESNT_EXIST(std::string(typeid(E).name())), *this);
+
+    const EventBuffer &previous = channel->previous;
+    const EventBuffer &current = channel->current;
+    size_t end = channel->firstEventID + previous.size + current.size;
+
+    // events older than the last tick are gone
+    cursor.next = std::max(cursor.next, channel->firstEventID);
+
+    for (; cursor.next < end; cursor.next++) {
+        size_t i = cursor.next - channel->firstEventID;
+
+        if (i < previous.size) {
+            func(static_cast<const E*>(previous.storage)[i]);
+        } else {
+            func(static_cast<const E*>(current.storage)[i - previous.size]);
+        }
+    }
+
+    return *this;
+}
+
+ECS &ECS::updateEvents() {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    publishEvents();
+
+    for (EventChannel *channel : eventChannels) {
+        if (channel == nullptr) continue;
+
+        size_t claimed = channel->reserved.load(std::memory_order_relaxed);
+
+        channel->firstEventID += channel->previous.size;
+        channel->destroyFunc(channel->previous);
+        std::swap(channel->previous, channel->current);
+
+        // make room for the events that were dropped last tick
+        if (claimed > channel->current.capacity) {
+            reserveEventBuffer(channel->current, channel->eventSize, claimed);
+        }
+
+        channel->reserved.store(0, std::memory_order_relaxed);
+    }
+
+    return *this;
+}
+
+template <typename E> 
+size_t ECS::getEventIndex() {
+    static const size_t index = eventTypeCount++;
+    return index;
+}
+
+template <typename E> 
+void ECS::destroyEvents(EventBuffer &buffer) {
+    E *events = static_cast<E*>(buffer.storage);
+
+    for (size_t i = 0; i < buffer.size; i++) {
+        events[i].~E();
+    }
+
+    buffer.size = 0;
+}
+
+template <typename E> 
+ECS::EventChannel *ECS::getEventChannel() {
+    size_t index = getEventIndex<E>();
+    return index < eventChannels.size() ? eventChannels[index] : nullptr;
+}
+
+void ECS::reserveEventBuffer(EventBuffer &buffer, size_t eventSize, size_t capacity) {
+    void* newStorage = new uint8_t[capacity * eventSize];
+
+    if (buffer.storage != nullptr) {
+        memcpy(newStorage, buffer.storage, eventSize * buffer.size);
+        delete[] static_cast<uint8_t*>(buffer.storage);
+    }
+
+    buffer.storage = newStorage;
+    buffer.capacity = capacity;
+}
+
+// Makes the events claimed by worker threads visible to readers
+void ECS::publishEvents() {
+    for (EventChannel *channel : eventChannels) {
+        if (channel == nullptr) continue;
+
+        channel->current.size = std::min(channel->reserved.load(std::memory_order_relaxed), channel->current.capacity);
+    }
+}
+
+// Indexes T by up to three arithmetic members registered with addMemberMeta. The index follows
+// adds and removes immediately, and picks up writes at the end of each system stage that had
+// access to T, or when updateSpatialIndex<T>() is called. Only the components handed out for 
+// writing since the last update are rechecked, every one of them after a loop or query over T.
+template <typename T>
+ECS &ECS::addSpatialIndex(std::vector<std::string> axisMembers, double cellSize) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.spatialIndex != nullptr, SPATIAL_INDEX_ALREADY_EXISTS(componentType.name), *this);
+    ECS_WARNING_IF(axisMembers.empty() || axisMembers.size() > 3, "Spatial index needs one to three axes", *this);
+    ECS_WARNING_IF(cellSize <= 0.0, "Spatial index cell size must be positive", *this);
+
+    std::vector<MemberMeta> axes;
+
+    for (const std::string &axisMember : axisMembers) {
+        auto memberIt = componentType.members.find(axisMember);
+        ECS_REFUSE_IF(memberIt == componentType.members.end(), MEMBER_DOESNT_EXIST(axisMember), *this);
+        ECS_REFUSE_IF(memberIt->second.toNumber == nullptr, MEMBER_IS_NOT_ARITHMETIC(axisMember), *this);
+        ECS_REFUSE_IF(componentType.coldSize > 0 && memberIt->second.offset >= componentType.coldOffset, 
+                      MEMBER_IS_COLD(axisMember), *this);
+
+        axes.push_back(memberIt->second);
+    }
+
+    SpatialIndex *spatialIndex = new SpatialIndex{.axes = axes, .cellSize = cellSize};
+
+    for (size_t i = 0; i < componentType.size; i++) {
+        insertIntoSpatialIndex(*spatialIndex, getOwner(componentType, i), getComponentPointer(componentType, i));
+    }
+
+    componentType.spatialIndex = spatialIndex;
+
+    if (componentType.indexChanges == nullptr) {
+        componentType.indexChanges = new IndexChanges();
+    }
+
+    return *this;
+}
+
+template <typename T>
+ECS &ECS::updateSpatialIndex() {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+    ECS_WARNING_IF(componentTypeIt->second.spatialIndex == nullptr, SPATIAL_INDEX_DOESNT_EXIST(componentTypeIt->second.name), *this);
+
+    updateIndexes(typeID, componentTypeIt->second); // the member indexes share the pending writes
+
+    return *this;
+}
+
+// Axes beyond the ones the index was built with are ignored
+template <typename T>
+std::vector<EntityID> ECS::queryAABB(std::array<double, 3> min, std::array<double, 3> max) {
+    return querySpatialIndex(typeid(T).hash_code(), min, max, [min, max](const std::array<double, 3> &position, size_t axes) {
+        for (size_t i = 0; i < axes; i++) {
+            if (position[i] < min[i] || position[i] > max[i]) return false;
+        }
+        return true;
+    });
+}
+
+template <typename T>
+std::vector<EntityID> ECS::queryRadius(std::array<double, 3> center, double radius) {
+    std::array<double, 3> min = {center[0] - radius, center[1] - radius, center[2] - radius};
+    std::array<double, 3> max = {center[0] + radius, center[1] + radius, center[2] + radius};
+
+    return querySpatialIndex(typeid(T).hash_code(), min, max, [center, radius](const std::array<double, 3> &position, size_t axes) {
+        double distanceSquared = 0.0;
+        for (size_t i = 0; i < axes; i++) {
+            distanceSquared += (position[i] - center[i]) * (position[i] - center[i]);
+        }
+        return distanceSquared <= radius * radius;
+    });
+}
+
+template <typename Test>
+std::vector<EntityID> ECS::querySpatialIndex(ComponentTypeID typeID, std::array<double, 3> min, std::array<double, 3> max, Test test) {
+    std::vector<EntityID> result;
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), result);
+
+    ComponentType &componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.spatialIndex == nullptr, SPATIAL_INDEX_DOESNT_EXIST(componentType.name), result);
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), result);
+
+    SpatialIndex &spatialIndex = *componentType.spatialIndex;
+    size_t axes = spatialIndex.axes.size();
+
+    auto testCell = [&](const std::vector<EntityID> &cell) {
+        for (EntityID entityID : cell) {
+            const void *component = getComponentPointer(componentType, (*entities)[entityID.id].componentIDs.at(typeID));
+
+            if (test(getSpatialPosition(spatialIndex, component), axes)) {
+                result.push_back(entityID);
+            }
+        }
+    };
+
+    std::array<int64_t, 3> minCell = {0, 0, 0};
+    std::array<int64_t, 3> maxCell = {0, 0, 0};
+    double cellCount = 1.0;
+
+    for (size_t i = 0; i < axes; i++) {
+        minCell[i] = (int64_t)std::floor(min[i] / spatialIndex.cellSize);
+        maxCell[i] = (int64_t)std::floor(max[i] / spatialIndex.cellSize);
+        cellCount *= (double)(maxCell[i] - minCell[i] + 1);
+    }
+
+    // Large boxes are cheaper to answer by scanning the occupied cells
+    if (cellCount > (double)spatialIndex.cells.size()) {
+        for (const auto &cell : spatialIndex.cells) {
+            testCell(cell.second);
+        }
+
+        return result;
+    }
+
+    for (int64_t x = minCell[0]; x <= maxCell[0]; x++) {
+        for (int64_t y = minCell[1]; y <= maxCell[1]; y++) {
+            for (int64_t z = minCell[2]; z <= maxCell[2]; z++) {
+                std::array<double, 3> position = {(x + 0.5) * spatialIndex.cellSize, 
+                                                  (y + 0.5) * spatialIndex.cellSize, 
+                                                  (z + 0.5) * spatialIndex.cellSize};
+
+                auto cellIt = spatialIndex.cells.find(getSpatialCell(spatialIndex, position));
+                if (cellIt != spatialIndex.cells.end()) {
+                    testCell(cellIt->second);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Indexes the values of a member registered with addMemberMeta. Hash indexes answer findByMember
+// in O(1), sorted indexes answer findByMember and findByMemberRange in O(log n). Adds and removes
+// are indexed immediately, writes are picked up at the end of each system stage that had access
+// to T, or when updateMemberIndexes<T>() is called, the same way as for addSpatialIndex.
+template <typename T>
+ECS &ECS::addMemberIndex(std::string memberName, MemberIndexType type) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.memberIndexes.find(memberName) != componentType.memberIndexes.end(), 
+                        MEMBER_INDEX_ALREADY_EXISTS(memberName), *this);
+
+    auto memberIt = componentType.members.find(memberName);
+    ECS_REFUSE_IF(memberIt == componentType.members.end(), MEMBER_DOESNT_EXIST(memberName), *this);
+    ECS_REFUSE_IF(memberIt->second.createIndex == nullptr, MEMBER_CANT_BE_INDEXED(memberName), *this);
+    ECS_REFUSE_IF(componentType.coldSize > 0 && memberIt->second.offset >= componentType.coldOffset, 
+                  MEMBER_IS_COLD(memberName), *this);
+
+    MemberIndex *memberIndex = memberIt->second.createIndex(type, memberIt->second.offset);
+    ECS_WARNING_IF(memberIndex == nullptr, MEMBER_CANT_BE_INDEXED(memberName), *this);
+
+    for (size_t i = 0; i < componentType.size; i++) {
+        memberIndex->insert(*memberIndex, getOwner(componentType, i), getComponentPointer(componentType, i));
+    }
+
+    componentType.memberIndexes[memberName] = memberIndex;
+
+    if (componentType.indexChanges == nullptr) {
+        componentType.indexChanges = new IndexChanges();
+    }
+
+    return *this;
+}
+
+template <typename T>
+ECS &ECS::updateMemberIndexes() {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    updateIndexes(typeID, componentTypeIt->second);
+
+    return *this;
+}
+
+template <typename T, typename V>
+std::vector<EntityID> ECS::findByMember(std::string memberName, const V &value) {
+    return findByMember<T, V>(memberName, value, value, false);
+}
+
+template <typename T, typename V>
+std::vector<EntityID> ECS::findByMemberRange(std::string memberName, const V &min, const V &max) {
+    return findByMember<T, V>(memberName, min, max, true);
+}
+
+template <typename T, typename V>
+std::vector<EntityID> ECS::findByMember(std::string memberName, const V &min, const V &max, bool isRange) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+    std::vector<EntityID> result;
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), result);
+
+    ComponentType& componentType = componentTypeIt->second;
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), result);
+
+    auto memberIndexIt = componentType.memberIndexes.find(memberName);
+    ECS_WARNING_IF(memberIndexIt == componentType.memberIndexes.end(), MEMBER_INDEX_DOESNT_EXIST(memberName), result);
+
+    MemberIndex &memberIndex = *memberIndexIt->second;
+    ECS_WARNING_IF(memberIndex.valueTypeID != typeid(V).hash_code(), "Value type doesn't match member '" + memberName + "'", result);
+    ECS_WARNING_IF(isRange && memberIndex.type != MemberIndexType::Sorted, "Member index on '" + memberName + "' isn't sorted", result);
+
+    memberIndex.find(memberIndex, &min, &max, result);
+
+    return result;
+}
+
+template <typename T>
+ECS &ECS::forEach(std::function<void(T&)> func, size_t threadCount) {
+    auto wrappedFunc = [func](EntityID, T& component) {
+        func(component);
+    };
+
+    forEach<T>(wrappedFunc, threadCount);
+
+    return *this;
+}
+
+template <typename T>
+ECS &ECS::forEach(std::function<void(EntityID, T&)> func, size_t threadCount) {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    ComponentType& componentType = componentTypeIt->second;
+
+    ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), *this);
+    ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), *this);
+    ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), *this);
+
+    markIndexesChanged(componentType);
+
+    uint8_t* componentStorage = static_cast<uint8_t*>(componentType.storage);
+    size_t componentSize = componentType.componentSize;
+    size_t ownerOffset = componentType.ownerOffset;
+    size_t totalSize = componentType.size;
+    size_t capacity = componentType.capacity;
+
+    threadCount = std::min(threadCount, totalSize);
+
+    if(threadCount <= 1){
+        for (size_t i = 0; i < componentType.size; i++) {
+            uint8_t* componentPtr = componentStorage + i * componentSize;
+            func(*reinterpret_cast<EntityID*>(componentPtr + ownerOffset), *reinterpret_cast<T*>(componentPtr));
+        }
+
+        return *this;
+    }
+
+    restrict();
+
+    std::vector<std::thread> threads;
+    size_t chunkSize = totalSize / threadCount;
+    size_t remainder = totalSize % threadCount;
+
+    size_t start = 0;
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+
+        threads.emplace_back([=, this]() {
+            if (settings.numaAware) bindWorkerToNode(start, end, capacity);
+
+            for (size_t j = start; j < end; j++) {
+                uint8_t* componentPtr = componentStorage + j * componentSize;
+                func(*reinterpret_cast<EntityID*>(componentPtr + ownerOffset), *reinterpret_cast<T*>(componentPtr));
+            }
+        });
+
+        start = end;
+    }
+
+    // Join all threads
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    unrestrict();
+
+    return *this;
+}
+
+template <typename Component1, typename Component2>
+ECS &ECS::forEach(std::function<void(Component1&, Component2&)> func, size_t threadCount) {
+    auto wrappedFunc = [func](EntityID, Component1& component1, Component2& component2) {
+        func(component1, component2);
+    };
+
+    forEach<Component1,Component2>(wrappedFunc, threadCount);
+
+    return *this;
+}
+
+template <typename Component1, typename Component2>
+ECS &ECS::forEach(std::function<void(EntityID, Component1&, Component2&)> func, size_t threadCount) {
+    return forEachQuery<Component1, Component2>(func, threadCount);
+}
+
+template<typename... Components, typename Func, typename ,
+            std::enable_if_t<is_query_invocable<Func, QueryArguments<Components...>>::value, long>>
+ECS &ECS::forEach(Func func, size_t threadCount) {
+    // Create a wrapper that adds the EntityID but ignores it when calling `func`
+    auto wrapper = [func](EntityID, auto&&... arguments) {
+        func(std::forward<decltype(arguments)>(arguments)...);
+    };
+
+    return forEachQuery<Components...>(wrapper, threadCount);
+}
+
+template<typename... Components, typename Func, typename ,
+            std::enable_if_t<is_query_invocable<Func, QueryArguments<Components...>, EntityID>::value, int>>
+ECS &ECS::forEach(Func func, size_t threadCount) {
+    return forEachQuery<Components...>(func, threadCount);
+}
+
+template <typename... Terms, typename Func>
+ECS &ECS::forEachQuery(Func &func, size_t threadCount) {
+    Query<Terms...> query;
+
+    if (!prepareQuery(query)) {
+        return *this;
+    }
+
+    return runQueryInParallel(query, func, threadCount);
+}
+
+template <typename Func>
+ECS &ECS::forEachDynamic(std::span<const ComponentTypeID> componentTypeIDs, Func func, size_t threadCount) {
+    DynamicQuery query;
+
+    if (!prepareQuery(query, componentTypeIDs)) {
+        return *this;
+    }
+
+    return runQueryInParallel(query, func, threadCount);
+}
+
+template <typename QueryType, typename Func>
+ECS &ECS::runQueryInParallel(QueryType &query, Func &func, size_t threadCount) {
+    size_t totalSize = query.driverSize;
+
+    threadCount = std::min(threadCount, totalSize);
+
+    if(threadCount <= 1){
+        runQuery(query, func, 0, totalSize);
+
+        return *this;
+    }
+
+    restrict();
+
+    // queries without a required term walk the entities instead of a pool
+    size_t capacity = query.driver != nullptr ? query.driver->capacity : entities->capacity();
+
+    std::vector<std::thread> threads;
+    size_t chunkSize = totalSize / threadCount;
+    size_t remainder = totalSize % threadCount;
+
+    size_t start = 0;
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+
+        threads.emplace_back([this, &query, func, capacity, start, end]() mutable {
+            if (settings.numaAware) bindWorkerToNode(start, end, capacity);
+
+            runQuery(query, func, start, end);
+        });
+
+        start = end;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    unrestrict();
+
+    return *this;
+}
+
+// `init` must be the identity of `combine`, every chunk starts from it. Partial results 
+// are combined in chunk order so the result only depends on the data and threadCount.
+template <typename... Components, typename Result, typename Map, typename Combine>
+Result ECS::forEachReduce(Result init, Map map, Combine combine, size_t threadCount) {
+    Query<Components...> query;
+
+    if (!prepareQuery(query)) {
+        return init;
+    }
+
+    size_t totalSize = query.driverSize;
+
+    threadCount = std::max<size_t>(std::min(threadCount, totalSize), 1);
+
+    std::vector<Result> partials(threadCount, init);
+
+    auto reduceChunk = [this, &query, &map, &combine](Result &accumulator, size_t start, size_t end) {
+        auto accumulate = [&accumulator, &map, &combine](EntityID entityID, auto&&... arguments) {
+            if constexpr (std::is_invocable_v<Map&, EntityID, decltype(arguments)...>) {
+                accumulator = combine(std::move(accumulator), map(entityID, std::forward<decltype(arguments)>(arguments)...));
+            } else {
+                accumulator = combine(std::move(accumulator), map(std::forward<decltype(arguments)>(arguments)...));
+            }
+        };
+
+        runQuery(query, accumulate, start, end);
+    };
+
+    if(threadCount <= 1){
+        reduceChunk(partials.at(0), 0, totalSize);
+
+        return partials.at(0);
+    }
+
+    restrict();
+
+    size_t capacity = query.driver != nullptr ? query.driver->capacity : entities->capacity();
+
+    std::vector<std::thread> threads;
+    size_t chunkSize = totalSize / threadCount;
+    size_t remainder = totalSize % threadCount;
+
+    size_t start = 0;
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+
+        // Each worker accumulates locally so the partials never share a cache line while running
+        threads.emplace_back([this, &query, &reduceChunk, &partials, &init, capacity, i, start, end]() {
+            if (settings.numaAware) bindWorkerToNode(start, end, capacity);
+
+            Result accumulator = init;
+            reduceChunk(accumulator, start, end);
+            partials[i] = std::move(accumulator);
+        });
+
+        start = end;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    unrestrict();
+
+    Result result = std::move(partials.at(0));
+    for (size_t i = 1; i < partials.size(); i++) {
+        result = combine(std::move(result), std::move(partials[i]));
+    }
+
+    return result;
+}
+
+template <typename... Terms>
+bool ECS::prepareQuery(Query<Terms...> &query) {
+    query.typeIDs = {typeid(typename QueryTerm<Terms>::Type).hash_code()...};
+
+    constexpr std::array<bool, sizeof...(Terms)> isRequired = {QueryTerm<Terms>::isRequired...};
+    constexpr std::array<bool, sizeof...(Terms)> isExcluded = {QueryTerm<Terms>::isExcluded...};
+    constexpr std::array<bool, sizeof...(Terms)> isFetched = {QueryTerm<Terms>::isFetched...};
+
+    for (size_t i = 0; i < sizeof...(Terms); i++) {
+        ComponentTypeID typeID = query.typeIDs[i];
+
+        auto componentTypeIt = componentTypes.find(typeID);
+        ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), false);
+
+        ComponentType &componentType = componentTypeIt->second;
+
+        // With and Without only look at which components an entity has, never at their data
+        if (isFetched[i]) {
+            ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), false);
+            ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), false);
+            ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), false);
+
+            markIndexesChanged(componentType);
+        }
+
+        query.componentTypes[i] = &componentType;
+
+        if (isRequired[i]) {
+            query.requiredSignature.set(componentType.index);
+        } else if (isExcluded[i]) {
+            query.excludedSignature.set(componentType.index);
+        }
+    }
+
+    planQuery(query, query.componentTypes);
+    return true;
+}
+
+bool ECS::prepareQuery(DynamicQuery &query, std::span<const ComponentTypeID> componentTypeIDs) {
+    query.typeIDs.assign(componentTypeIDs.begin(), componentTypeIDs.end());
+
+    for (ComponentTypeID typeID : componentTypeIDs) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), false);
+
+        ComponentType &componentType = componentTypeIt->second;
+        ECS_WARNING_IF(componentType.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentType.name), false);
+        ECS_WARNING_IF(componentType.isLocked, COMPONENT_TYPE_IS_LOCKED(componentType.name), false);
+        ECS_REFUSE_IF(componentType.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentType.name), false);
+
+        markIndexesChanged(componentType);
+
+        query.componentTypes.push_back(&componentType);
+        query.requiredSignature.set(componentType.index);
+    }
+
+    planQuery(query, query.componentTypes);
+    return true;
+}
+
+// Drives the join from the smallest required pool
+void ECS::planQuery(QueryPlan &query, std::span<ComponentType* const> componentTypes) {
+    for (ComponentType *componentType : componentTypes) {
+        if (!query.requiredSignature.test(componentType->index)) continue;
+
+        if (query.driver == nullptr || componentType->size < query.driver->size) {
+            query.driver = componentType;
+        }
+    }
+
+    // Queries without a required term walk every entity instead of a pool
+    if (query.driver == nullptr) {
+        query.driverSize = entities->size();
+        return;
+    }
+
+    query.driverSize = query.driver->size;
+    query.drivenSignature.set(query.driver->index);
+
+    // A group owned entirely by the required terms is a smaller driver whose indices line up in every pool
+    for (ComponentType *componentType : componentTypes) {
+        const ComponentSignature &groupSignature = componentType->groupSignature;
+
+        if (groupSignature.none() || (query.requiredSignature & groupSignature) != groupSignature) continue;
+
+        if (componentType->groupSize <= query.driverSize) {
+            query.driver = componentType;
+            query.driverSize = componentType->groupSize;
+            query.drivenSignature = groupSignature;
+        }
+    }
+}
+
+bool ECS::matchesQuery(const QueryPlan &query, const Entity &entity) const {
+    return (entity.signature & query.requiredSignature) == query.requiredSignature &&
+           (entity.signature & query.excludedSignature).none();
+}
+
+template <typename... Terms, typename Func>
+void ECS::runQuery(Query<Terms...> &query, Func &func, size_t start, size_t end) {
+    if (query.driver != nullptr && settings.prefetchDistance > 0) {
+        runQueryPrefetched(query, func, start, end);
+        return;
+    }
+
+    for (size_t i = start; i < end; i++) {
+        EntityID entityID = query.driver != nullptr ? getOwner(*query.driver, i) : EntityID{i};
+        Entity &entity = (*entities)[entityID.id];
+
+        if (!matchesQuery(query, entity)) {
+            continue;
+        }
+
+        // Driven terms share the driver's component index, every other term is looked up
+        [&]<size_t... Indices>(std::index_sequence<Indices...>) {
+            std::apply(func, std::tuple_cat(std::make_tuple(entityID), 
+                fetchQueryTerm<Terms>(query.componentTypes[Indices], query.typeIDs[Indices], entity,
+                                      query.drivenSignature.test(query.componentTypes[Indices]->index) ? i : SIZE_MAX)...));
+        }(std::index_sequence_for<Terms...>{});
+    }
+}
+
+// Every term is required, so a matching entity has all of them. The pointers are gathered into
+// one array per worker that the callback sees as void**.
+template <typename Func>
+void ECS::runQuery(DynamicQuery &query, Func &func, size_t start, size_t end) {
+    std::vector<void*> components(query.componentTypes.size());
+
+    for (size_t i = start; i < end; i++) {
+        EntityID entityID = query.driver != nullptr ? getOwner(*query.driver, i) : EntityID{i};
+        Entity &entity = (*entities)[entityID.id];
+
+        if (!matchesQuery(query, entity)) {
+            continue;
+        }
+
+        for (size_t j = 0; j < components.size(); j++) {
+            ComponentType &componentType = *query.componentTypes[j];
+            size_t componentID = query.drivenSignature.test(componentType.index) ? i : entity.componentIDs.at(query.typeIDs[j]);
+            components[j] = getComponentPointer(componentType, componentID);
+        }
+
+        func(entityID, components.data());
+    }
+}
+
+// Same as runQuery, but the entity and component indices of i + distance are resolved while
+// i is processed and their slots prefetched, so the random reads into the entity table and 
+// the other pools overlap with the callback instead of stalling it.
+template <typename... Terms, typename Func>
+void ECS::runQueryPrefetched(Query<Terms...> &query, Func &func, size_t start, size_t end) {
+    struct Resolved {
+        EntityID entityID;
+        bool matches;
+        std::array<size_t, sizeof...(Terms)> componentIDs;
+    };
+
+    const size_t distance = settings.prefetchDistance;
+    std::vector<Resolved> resolvedRing(distance);
+
+    auto resolve = [&](size_t i, Resolved &resolved) {
+        resolved.entityID = getOwner(*query.driver, i);
+
+        Entity &entity = (*entities)[resolved.entityID.id];
+        resolved.matches = matchesQuery(query, entity);
+
+        if (resolved.matches) {
+            [&]<size_t... Indices>(std::index_sequence<Indices...>) {
+                ((resolved.componentIDs[Indices] = resolveQueryTerm<Terms>(query.componentTypes[Indices], query.typeIDs[Indices], entity,
+                    query.drivenSignature.test(query.componentTypes[Indices]->index) ? i : SIZE_MAX)), ...);
+            }(std::index_sequence_for<Terms...>{});
+        }
+    };
+
+    // The callback may add or remove components, which swaps slots around under entries resolved earlier
+    auto isStale = [&](size_t i, const Resolved &resolved) {
+        if (getOwner(*query.driver, i).id != resolved.entityID.id ||
+            matchesQuery(query, (*entities)[resolved.entityID.id]) != resolved.matches) {
+            return true;
+        }
+
+        for (size_t j = 0; j < sizeof...(Terms); j++) {
+            size_t componentID = resolved.componentIDs[j];
+            if (resolved.matches && componentID != SIZE_MAX && (componentID >= query.componentTypes[j]->size || 
+                getOwner(*query.componentTypes[j], componentID).id != resolved.entityID.id)) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    for (size_t i = start; i < std::min(end, start + distance); i++) {
+        resolve(i, resolvedRing[i % distance]);
+    }
+
+    for (size_t i = start; i < end; i++) {
+        Resolved resolved = resolvedRing[i % distance];
+
+        if (i + distance < end) {
+            resolve(i + distance, resolvedRing[i % distance]);
+
+            // only pulled in for now, it gets resolved once the loop is distance entities further
+            if (i + 2 * distance < end) {
+                ECS_PREFETCH(&(*entities)[getOwner(*query.driver, i + 2 * distance).id]);
+            }
+        }
+
+        if (isStale(i, resolved)) {
+            resolve(i, resolved);
+        }
+
+        if (!resolved.matches) {
+            continue;
+        }
+
+        Entity &entity = (*entities)[resolved.entityID.id];
+
+        [&]<size_t... Indices>(std::index_sequence<Indices...>) {
+            std::apply(func, std::tuple_cat(std::make_tuple(resolved.entityID), 
+                fetchQueryTerm<Terms>(query.componentTypes[Indices], query.typeIDs[Indices], entity, resolved.componentIDs[Indices])...));
+        }(std::index_sequence_for<Terms...>{});
+    }
+}
+
+// Returns the component index of a fetched term and prefetches its slot, SIZE_MAX if there is none
+template <typename Term>
+size_t ECS::resolveQueryTerm(ComponentType *componentType, ComponentTypeID typeID, Entity &entity, size_t componentID) {
+    if constexpr (!QueryTerm<Term>::isFetched) {
+        return SIZE_MAX;
+    } else {
+        if (componentID != SIZE_MAX) {
+            return componentID; // driven, read in order anyway
+        }
+
+        auto componentIndexIt = entity.componentIDs.find(typeID);
+        if (componentIndexIt == entity.componentIDs.end()) {
+            return SIZE_MAX;
+        }
+
+        ECS_PREFETCH(static_cast<const char*>(componentType->storage) + componentIndexIt->second * componentType->componentSize);
+        return componentIndexIt->second;
+    }
+}
+
+// 0 turns prefetching off. Whether it pays depends on the machine, examples/benchmark.cpp
+// times a few distances.
+ECS &ECS::setPrefetchDistance(size_t distance) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    settings.prefetchDistance = distance;
+    return *this;
+}
+
+template <typename Term>
+auto ECS::fetchQueryTerm(ComponentType *componentType, ComponentTypeID typeID, Entity &entity, size_t componentID) {
+    using T = typename QueryTerm<Term>::Type;
+
+    if constexpr (!QueryTerm<Term>::isFetched) {
+        return std::tuple<>();
+    } else {
+        if (componentID == SIZE_MAX) {
+            auto componentIndexIt = entity.componentIDs.find(typeID);
+
+            if constexpr (QueryTerm<Term>::isOptional) {
+                if (componentIndexIt == entity.componentIDs.end()) {
+                    return std::tuple<T*>(nullptr);
+                }
+            }
+
+            componentID = componentIndexIt->second;
+        }
+
+        T* component = static_cast<T*>(getComponentPointer(*componentType, componentID));
+
+        if constexpr (QueryTerm<Term>::isOptional) {
+            return std::tuple<T*>(component);
+        } else {
+            return std::tuple<T&>(*component);
+        }
+    }
+}
+
+EntityID ECS::getOwner(const ComponentType &componentType, size_t componentID) {
+    const char* componentStorage = static_cast<const char*>(componentType.storage);
+    return *reinterpret_cast<const EntityID*>(componentStorage + componentID * componentType.componentSize + componentType.ownerOffset);
+}
+
+SystemBatchID ECS::addSystemBatch() {
+    ECS_ERROR_IF(restricted, ECS_IS_RESTRICTED);
+
+    SystemBatchID id = generateSystemBatchID();
+    systemBatches[id] = SystemBatch();
+    return id;
+};
+
+template <typename... Components>
+ECS &ECS::addSystem(SystemBatchID batchID, std::function<void(ECS&)> func) {
+    return addSystem(batchID, {typeid(Components).hash_code()...}, func);
+}
+
+// No types declared means the system may touch every type
+ECS &ECS::addSystem(SystemBatchID batchID, std::vector<ComponentTypeID> componentTypeIDs, std::function<void(ECS&)> func) {
+
+    auto systemBatchIt = systemBatches.find(batchID);
+    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(batchID)), *this);
+
+    SystemBatch& systemBatch = systemBatchIt->second;
+
+    if(componentTypeIDs.size() == 0){
+        componentTypeIDs = getAllComponentTypeIDs();
+    }
+
+    for(size_t i = 0; i < componentTypeIDs.size(); i++){
+        bool exists = componentTypes.find(componentTypeIDs[i]) != componentTypes.end() || findResource(componentTypeIDs[i]) != nullptr;
+        ECS_WARNING_IF(!exists, COMPONENT_TYPE_DOESNT_EXIST(std::to_string(componentTypeIDs[i])), *this);
+    }
+
+    for(size_t j = 0; j < systemBatch.parallelSystems.size(); j++){
+        FrameArena::Marker marker = arena->mark();
+        FrameVector<ComponentTypeID> parallelSystemComponentIDs = getParallelSystemComponentIDs(batchID, j);
+        bool fits = !haveCommonElements(parallelSystemComponentIDs, componentTypeIDs);
+        arena->rewind(marker);
+
+        if(fits){
+            systemBatch.parallelSystems.at(j).push_back({componentTypeIDs, func});
+
+            return *this;
+        }
+    }
+
+    systemBatch.parallelSystems.push_back({{componentTypeIDs, func}});
+
+    return *this;
+}
+
+template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(T&)> func){
+    auto newFunc = [func](ECS&, EntityID, T& component) {
+        func(component);
+    };
+
+    return addSystem<T>(systemType, newFunc);
+}
+template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(EntityID, T&)> func){
+    auto newFunc = [func](ECS&, EntityID entityID, T& component) {
+        func(entityID, component);
+    };
+
+    return addSystem<T>(systemType, newFunc);
+}
+
+template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(ECS&, EntityID, T&)> func){
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(componentTypes.find(typeID) == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+    ECS_WARNING_IF(componentTypes.find(typeID)->second.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentTypes.find(typeID)->second.name), *this);
+    ECS_WARNING_IF(componentTypes.find(typeID)->second.isLocked, COMPONENT_TYPE_IS_LOCKED(componentTypes.find(typeID)->second.name), *this);
+    ECS_REFUSE_IF(componentTypes.find(typeID)->second.coldSize > 0, COMPONENT_TYPE_IS_SPLIT(componentTypes.find(typeID)->second.name), *this);
+
+    auto newFunc = [func](ECS& ecs, EntityID entityID, void *component) {
+        func(ecs, entityID, *static_cast<T*>(component));
+    };
+
+    if(systemType == SYSTEM_ADD_COMPONENT){
+        observers[typeID].onAdd.push_back(newFunc);
+    } else if(systemType == SYSTEM_REMOVE_COMPONENT){
+        observers[typeID].onRemove.push_back(newFunc);
+    } else{
+        ECS_WARNING_IF(true, INVALID_SYSTEM_TYPE, *this);
+    }
+
+    return *this;
+}
+
+// Batched observers receive the GUIDs of every entity that gained or lost T since the last sync point.
+// Removed entities may no longer exist, added ones are only reported if they still have T.
+template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(ECS&, std::span<const EntityGUID>)> func){
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(componentTypes.find(typeID) == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
+
+    if(systemType == SYSTEM_ADD_COMPONENT_BATCH){
+        observers[typeID].onAddBatch.push_back(func);
+    } else if(systemType == SYSTEM_REMOVE_COMPONENT_BATCH){
+        observers[typeID].onRemoveBatch.push_back(func);
+    } else{
+        ECS_WARNING_IF(true, INVALID_SYSTEM_TYPE, *this);
+    }
+
+    return *this;
+}
+
+ECS &ECS::runSystemBatch(SystemBatchID id){
+    auto systemBatchIt = systemBatches.find(id);
+    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(id)), *this);
+
+    SystemBatch &systemBatch = systemBatchIt->second;
+
+    {
+        AccessToken syncToken = acquire({}, true);
+        commitEntities();
+        flushObservers();
+    }
+
+    for(size_t i = 0; i < systemBatch.parallelSystems.size(); i++){
+        std::vector<System> &parallelSystem = systemBatch.parallelSystems.at(i);
+        FrameVector<ComponentTypeID> parallelSystemComponentIDs = getParallelSystemComponentIDs(id, i);
+
+        AccessToken stageToken = acquire(parallelSystemComponentIDs, true);
+
+        std::vector<std::thread> threads;
+        std::vector<ECS> ecss;
+
+        for(size_t j = 0; j < parallelSystem.size(); j++){
+            ecss.push_back(split(parallelSystem.at(j).componentTypeIDs));
+        }
+
+        for(size_t j = 0; j < parallelSystem.size(); j++){
+            System &system = parallelSystem.at(j);
+
+            ECS &splitECS = ecss.at(j);
+
+            threads.emplace_back([&system, &splitECS]() {
+                system.func(splitECS);
+            });
+        }
+
+        for(auto &thread : threads){
+            thread.join();
+        }
+
+        killChildren();
+        stageToken.release();
+
+        AccessToken syncToken = acquire({}, true);
+        sync(parallelSystemComponentIDs);
+    }
+
+    arena->reset();
+
+    return *this;
+}
+
+template <typename... Components> 
+AccessToken ECS::acquireRead() {
+    std::array<ComponentTypeID, sizeof...(Components)> typeIDs = {typeid(Components).hash_code()...};
+    return acquire(typeIDs, false);
+}
+
+template <typename... Components> 
+AccessToken ECS::acquireWrite() {
+    std::array<ComponentTypeID, sizeof...(Components)> typeIDs = {typeid(Components).hash_code()...};
+    return acquire(typeIDs, true);
+}
+
+template <typename T> 
+AccessStats ECS::getAccessStats() {
+    ComponentTypeID typeID = typeid(T).hash_code();
+
+    auto componentTypeIt = componentTypes.find(typeID);
+    ECS_WARNING_IF(componentTypeIt == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), AccessStats{});
+
+    return getAccessStats(*componentTypeIt->second.accessLock);
+}
+
+AccessStats ECS::getAccessStats() {
+    ECS_WARNING_IF(structureLock == nullptr, ACCESS_TOKEN_NOT_ROOT, AccessStats{});
+    return getAccessStats(*structureLock);
+}
+
+AccessStats ECS::getAccessStats(const AccessLock &accessLock) {
+    return AccessStats{
+        .reads = accessLock.reads.load(),
+        .writes = accessLock.writes.load(),
+        .contendedReads = accessLock.contendedReads.load(),
+        .contendedWrites = accessLock.contendedWrites.load(),
+        .waitSeconds = accessLock.waitNanoseconds.load() / 1e9,
+    };
+}
+
+// With no component types a write token covers the whole ECS. Locks are always taken in
+// the same order, entity table first and then by component index, so tokens can't deadlock.
+AccessToken ECS::acquire(std::span<const ComponentTypeID> componentTypeIDs, bool write) {
+    AccessToken token;
+
+    ECS_WARNING_IF(structureLock == nullptr, ACCESS_TOKEN_NOT_ROOT, token);
+
+    if (componentTypeIDs.empty()) {
+        structureLock->lock(write);
+        token.locks.push_back({structureLock, write});
+        return token;
+    }
+
+    std::vector<ComponentType*> lockedTypes;
+    for (ComponentTypeID typeID : componentTypeIDs) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        if (componentTypeIt == componentTypes.end()) continue; // resources have no lock
+
+        ComponentType &componentType = componentTypeIt->second;
+        if (write && componentType.isReadOnly) continue; // nobody can write it anyway
+
+        lockedTypes.push_back(&componentType);
+    }
+
+    std::sort(lockedTypes.begin(), lockedTypes.end(), [](ComponentType *a, ComponentType *b) {
+        return a->index < b->index;
+    });
+    lockedTypes.erase(std::unique(lockedTypes.begin(), lockedTypes.end()), lockedTypes.end());
+
+    structureLock->lock(false);
+    token.locks.push_back({structureLock, false});
+
+    for (ComponentType *componentType : lockedTypes) {
+        componentType->accessLock->lock(write);
+        token.locks.push_back({componentType->accessLock, write});
+    }
+
+    return token;
+}
+
+void AccessLock::lock(bool exclusive) {
+    if (exclusive ? mutex.try_lock() : mutex.try_lock_shared()) {
+        (exclusive ? writes : reads).fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (exclusive) {
+        mutex.lock();
+    } else {
+        mutex.lock_shared();
+    }
+
+    auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    waitNanoseconds.fetch_add(waited.count(), std::memory_order_relaxed);
+    (exclusive ? writes : reads).fetch_add(1, std::memory_order_relaxed);
+    (exclusive ? contendedWrites : contendedReads).fetch_add(1, std::memory_order_relaxed);
+}
+
+void AccessLock::unlock(bool exclusive) {
+    if (exclusive) {
+        mutex.unlock();
+    } else {
+        mutex.unlock_shared();
+    }
+}
+
+AccessToken::AccessToken(AccessToken &&other) noexcept : locks(std::move(other.locks)) {
+    other.locks.clear();
+}
+
+AccessToken &AccessToken::operator=(AccessToken &&other) noexcept {
+    if (this != &other) {
+        release();
+        locks = std::move(other.locks);
+        other.locks.clear();
+    }
+    return *this;
+}
+
+AccessToken::~AccessToken() {
+    release();
+}
+
+// Unlocks in reverse order of locking
+void AccessToken::release() {
+    for (auto it = locks.rbegin(); it != locks.rend(); it++) {
+        it->first->unlock(it->second);
+    }
+    locks.clear();
+}
+
+std::vector<ComponentTypeID> ECS::getAllComponentTypeIDs() {
+    std::vector<ComponentTypeID> componentTypeIDs;
+
+    for (const auto& componentTypeID : componentTypes) {
+        componentTypeIDs.push_back(componentTypeID.first);
+    }
+
+    for (const auto& resource : resources) {
+        if (resource.data != nullptr) {
+            componentTypeIDs.push_back(resource.typeID);
+        }
+    }
+
+    return componentTypeIDs;
+}
+
+// Allocated from the frame arena, runSystemBatch asks for these every stage
+FrameVector<ComponentTypeID> ECS::getParallelSystemComponentIDs(SystemBatchID id, size_t index){
+    FrameVector<ComponentTypeID> componentTypeIDs = frameVector<ComponentTypeID>();
+
+    auto systemBatchIt = systemBatches.find(id);
+    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(id)), componentTypeIDs);
+
+    SystemBatch &systemBatch = systemBatchIt->second;
+
+    std::vector<System> &parallelSystem = systemBatch.parallelSystems.at(index);
+
+    for(size_t i = 0; i < parallelSystem.size(); i++){
+        System &system = parallelSystem.at(i);
+
+        for(size_t j = 0; j < system.componentTypeIDs.size(); j++){
+            componentTypeIDs.push_back(parallelSystem.at(i).componentTypeIDs.at(j));
+        }
+    }
+
+    return componentTypeIDs;
+}
+
+bool ECS::haveCommonElements(std::span<const ComponentTypeID> vec1, std::span<const ComponentTypeID> vec2) {
+    for (ComponentTypeID id1 : vec1) {
+        for (ComponentTypeID id2 : vec2) {
+            if (id1 == id2) {
+                return true; // Found a common element
+            }
+        }
+    }
+
+    return false; // No common elements
+}
+
+// Called once systems that had access to componentTypeIDs have finished
+ECS &ECS::sync(std::span<const ComponentTypeID> componentTypeIDs) {
+    for (ComponentTypeID typeID : componentTypeIDs) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        if (componentTypeIt == componentTypes.end()) continue;
+
+        updateIndexes(typeID, componentTypeIt->second);
+    }
+
+    publishEvents();
+    commitEntities();
+    flushObservers();
+
+    return *this;
+}
+
+// Delivers the pending batched notifications, called at every sync point of runSystemBatch
+ECS &ECS::flushObservers() {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    struct PendingNotifications {
+        ComponentTypeID typeID;
+        std::vector<EntityGUID> added;
+        std::vector<EntityGUID> removed;
+    };
+
+    // taken out for every type first, the observers may add observers (rehashing the map) or 
+    // add and remove more components, which are delivered at the next flush
+    std::vector<PendingNotifications> pending;
+    for (auto &[typeID, typeObservers] : observers) {
+        if (typeObservers.added.empty() && typeObservers.removed.empty()) continue;
+
+        pending.push_back({typeID, std::move(typeObservers.added), std::move(typeObservers.removed)});
+        typeObservers.added.clear();
+        typeObservers.removed.clear();
+    }
+
+    for (auto &[typeID, added, removed] : pending) {
+        auto componentTypeIt = componentTypes.find(typeID);
+        if (componentTypeIt == componentTypes.end()) continue;
+
+        size_t index = componentTypeIt->second.index;
+
+        std::erase_if(added, [this, index](EntityGUID guid) {
+            auto entityIt = entitiesMap->find(guid);
+            return entityIt == entitiesMap->end() || !(*entities)[entityIt->second.id].signature.test(index);
+        });
+
+        // looked up again before each list, the previous callbacks may have rehashed the map
+        if (!added.empty()) {
+            for (auto &func : std::vector(observers.at(typeID).onAddBatch)) {
+                func(*this, added);
+            }
+        }
+
+        if (!removed.empty()) {
+            for (auto &func : std::vector(observers.at(typeID).onRemoveBatch)) {
+                func(*this, removed);
+            }
+        }
+    }
+
+    return *this;
+}
+
+void ECS::notifyAdded(ComponentTypeID typeID, EntityID entityID, void *component) {
+    auto observersIt = observers.find(typeID);
+    if (observersIt == observers.end()) return;
+
+    ComponentObservers &typeObservers = observersIt->second;
+
+    if (!typeObservers.onAddBatch.empty()) {
+        typeObservers.added.push_back((*entities)[entityID.id].guid);
+    }
+
+    if (typeObservers.onAdd.empty()) return;
+
+    markIndexChanged(componentTypes.at(typeID), entityID); // the observers get it to write
+
+    // copied, an observer may register more observers, and the component is looked up again
+    // after each call in case an observer moved or removed it
+    for (auto &func : std::vector(typeObservers.onAdd)) {
+        if (component == nullptr) return;
+        func(*this, entityID, component);
+        component = findObservedComponent(typeID, entityID);
+    }
+}
+
+void ECS::notifyRemoved(ComponentTypeID typeID, EntityID entityID, void *component) {
+    auto observersIt = observers.find(typeID);
+    if (observersIt == observers.end()) return;
+
+    ComponentObservers &typeObservers = observersIt->second;
+
+    if (!typeObservers.onRemoveBatch.empty()) {
+        typeObservers.removed.push_back((*entities)[entityID.id].guid);
+    }
+
+    if (typeObservers.onRemove.empty()) return;
+
+    // same as notifyAdded
+    for (auto &func : std::vector(typeObservers.onRemove)) {
+        if (component == nullptr) return;
+        func(*this, entityID, component);
+        component = findObservedComponent(typeID, entityID);
+    }
+}
+
+// The component of typeID of entityID, null if it's gone
+void *ECS::findObservedComponent(ComponentTypeID typeID, EntityID entityID) {
+    auto componentTypeIt = componentTypes.find(typeID);
+    if (componentTypeIt == componentTypes.end() || entityID.id >= entities->size()) return nullptr;
+
+    auto componentIDIt = (*entities)[entityID.id].componentIDs.find(typeID);
+    if (componentIDIt == (*entities)[entityID.id].componentIDs.end()) return nullptr;
+
+    return getComponentPointer(componentTypeIt->second, componentIDIt->second);
+}
+
+void ECS::indexComponent(ComponentType &componentType, EntityID entityID, const void *component) {
+    if (componentType.spatialIndex != nullptr) {
+        insertIntoSpatialIndex(*componentType.spatialIndex, entityID, component);
+    }
+
+    for (auto &memberIndex : componentType.memberIndexes) {
+        memberIndex.second->insert(*memberIndex.second, entityID, component);
+    }
+}
+
+void ECS::unindexComponent(ComponentType &componentType, EntityID entityID) {
+    if (componentType.spatialIndex != nullptr) {
+        eraseFromSpatialIndex(*componentType.spatialIndex, entityID);
+    }
+
+    for (auto &memberIndex : componentType.memberIndexes) {
+        memberIndex.second->erase(*memberIndex.second, entityID);
+    }
+}
+
+void ECS::moveIndexedEntity(ComponentType &componentType, EntityID from, EntityID to) {
+    if (componentType.spatialIndex != nullptr) {
+        moveInSpatialIndex(*componentType.spatialIndex, from, to);
+    }
+
+    for (auto &memberIndex : componentType.memberIndexes) {
+        memberIndex.second->move(*memberIndex.second, from, to);
+    }
+
+    // a pending write follows the entity to its new id
+    if (componentType.indexChanges != nullptr && !componentType.indexChanges->entities.empty()) {
+        componentType.indexChanges->entities.push_back(to);
+    }
+}
+
+void ECS::reindexComponent(ComponentType &componentType, EntityID entityID, const void *component) {
+    if (componentType.spatialIndex != nullptr) {
+        updateInSpatialIndex(*componentType.spatialIndex, entityID, component);
+    }
+
+    for (auto &memberIndex : componentType.memberIndexes) {
+        memberIndex.second->update(*memberIndex.second, entityID, component);
+    }
+}
+
+// Called when a single component of an indexed type is handed out for writing
+void ECS::markIndexChanged(ComponentType &componentType, EntityID entityID) {
+    IndexChanges *indexChanges = componentType.indexChanges;
+    if (indexChanges == nullptr) return;
+
+    // workers can't share the list, and past one entry per component a rescan is cheaper
+    if (restricted || indexChanges->entities.size() >= componentType.size) {
+        indexChanges->all.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    indexChanges->entities.push_back(entityID);
+}
+
+// Called when every component of an indexed type may have been written
+void ECS::markIndexesChanged(ComponentType &componentType) {
+    if (componentType.indexChanges != nullptr) {
+        componentType.indexChanges->all.store(true, std::memory_order_relaxed);
+    }
+}
+
+// Picks up writes made through references since the indexes were last updated
+void ECS::updateIndexes(ComponentTypeID typeID, ComponentType &componentType) {
+    IndexChanges *indexChanges = componentType.indexChanges;
+    if (indexChanges == nullptr) return;
+
+    if (indexChanges->all.exchange(false, std::memory_order_relaxed)) {
+        for (size_t i = 0; i < componentType.size; i++) {
+            reindexComponent(componentType, getOwner(componentType, i), getComponentPointer(componentType, i));
+        }
+    } else {
+        for (EntityID entityID : indexChanges->entities) {
+            // removed since, removals are unindexed straight away
+            if (entityID.id >= entities->size()) continue;
+
+            auto componentIDIt = (*entities)[entityID.id].componentIDs.find(typeID);
+            if (componentIDIt == (*entities)[entityID.id].componentIDs.end()) continue;
+
+            reindexComponent(componentType, entityID, getComponentPointer(componentType, componentIDIt->second));
+        }
+    }
+
+    indexChanges->entities.clear();
+}
+
+template <typename V>
+MemberIndex* ECS::createMemberIndex(MemberIndexType type, size_t offset) {
+    if (type == MemberIndexType::Hash) {
+        if constexpr (is_hashable<V>::value) {
+            return newMemberIndex<std::unordered_multimap<V, EntityID>>(type, offset);
+        }
+    } else {
+        if constexpr (is_less_comparable<V>::value) {
+            return newMemberIndex<std::multimap<V, EntityID>>(type, offset);
+        }
+    }
+
+    return nullptr;
+}
+
+template <typename Map>
+MemberIndex* ECS::newMemberIndex(MemberIndexType type, size_t offset) {
+    return new MemberIndex{
+        .type = type,
+        .offset = offset,
+        .valueTypeID = typeid(typename Map::key_type).hash_code(),
+        .values = new MemberIndexValues<Map>(),
+        .insert = insertMemberIndex<Map>,
+        .erase = eraseMemberIndex<Map>,
+        .move = moveMemberIndex<Map>,
+        .update = updateMemberIndex<Map>,
+        .find = findMemberIndex<Map>,
+        .destroy = destroyMemberIndex<Map>,
+        .memoryUsage = getMemberIndexMemory<Map>,
+    };
+}
+
+template <typename Map>
+void ECS::insertMemberIndex(MemberIndex &memberIndex, EntityID entityID, const void *component) {
+    using Value = typename Map::key_type;
+    MemberIndexValues<Map> &values = *static_cast<MemberIndexValues<Map>*>(memberIndex.values);
+
+    const Value &value = *reinterpret_cast<const Value*>(static_cast<const uint8_t*>(component) + memberIndex.offset);
+
+    values.values.emplace(value, entityID);
+    values.entityValues[entityID.id] = value;
+}
+
+template <typename Map>
+void ECS::eraseMemberIndex(MemberIndex &memberIndex, EntityID entityID) {
+    MemberIndexValues<Map> &values = *static_cast<MemberIndexValues<Map>*>(memberIndex.values);
+
+    auto entityValueIt = values.entityValues.find(entityID.id);
+    if (entityValueIt == values.entityValues.end()) return;
+
+    auto range = values.values.equal_range(entityValueIt->second);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == entityID) {
+            values.values.erase(it);
+            break;
+        }
+    }
+
+    values.entityValues.erase(entityValueIt);
+}
+
+template <typename Map>
+void ECS::moveMemberIndex(MemberIndex &memberIndex, EntityID from, EntityID to) {
+    MemberIndexValues<Map> &values = *static_cast<MemberIndexValues<Map>*>(memberIndex.values);
+
+    auto entityValueIt = values.entityValues.find(from.id);
+    if (entityValueIt == values.entityValues.end()) return;
+
+    auto range = values.values.equal_range(entityValueIt->second);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == from) {
+            it->second = to;
+            break;
+        }
+    }
+
+    values.entityValues[to.id] = entityValueIt->second;
+    values.entityValues.erase(from.id);
+}
+
+template <typename Map>
+void ECS::updateMemberIndex(MemberIndex &memberIndex, EntityID entityID, const void *component) {
+    using Value = typename Map::key_type;
+    MemberIndexValues<Map> &values = *static_cast<MemberIndexValues<Map>*>(memberIndex.values);
+
+    const Value &value = *reinterpret_cast<const Value*>(static_cast<const uint8_t*>(component) + memberIndex.offset);
+    const Value &indexedValue = values.entityValues.at(entityID.id);
+
+    bool isSame;
+    if constexpr (std::is_same_v<Map, std::unordered_multimap<Value, EntityID>>) {
+        isSame = values.values.key_eq()(value, indexedValue);
+    } else {
+        isSame = !values.values.key_comp()(value, indexedValue) && !values.values.key_comp()(indexedValue, value);
+    }
+
+    if (isSame) return;
+
+    eraseMemberIndex<Map>(memberIndex, entityID);
+    insertMemberIndex<Map>(memberIndex, entityID, component);
+}
+
+// Hash indexes only look up `min`, sorted indexes return every value in [min, max]
+template <typename Map>
+void ECS::findMemberIndex(const MemberIndex &memberIndex, const void *min, const void *max, std::vector<EntityID> &result) {
+    using Value = typename Map::key_type;
+    const MemberIndexValues<Map> &values = *static_cast<const MemberIndexValues<Map>*>(memberIndex.values);
+
+    const Value &minValue = *static_cast<const Value*>(min);
+
+    if (memberIndex.type == MemberIndexType::Hash) {
+        auto range = values.values.equal_range(minValue);
+        for (auto it = range.first; it != range.second; ++it) {
+            result.push_back(it->second);
+        }
+        return;
+    }
+
+    if constexpr (std::is_same_v<Map, std::multimap<Value, EntityID>>) {
+        const Value &maxValue = *static_cast<const Value*>(max);
+        if (maxValue < minValue) return;
+
+        auto end = values.values.upper_bound(maxValue);
+        for (auto it = values.values.lower_bound(minValue); it != end; ++it) {
+            result.push_back(it->second);
+        }
+    }
+}
+
+template <typename Map>
+void ECS::destroyMemberIndex(MemberIndex &memberIndex) {
+    delete static_cast<MemberIndexValues<Map>*>(memberIndex.values);
+    memberIndex.values = nullptr;
+}
+
+template <typename Map>
+MemoryUsage ECS::getMemberIndexMemory(const MemberIndex &memberIndex) {
+    const MemberIndexValues<Map> &values = *static_cast<const MemberIndexValues<Map>*>(memberIndex.values);
+
+    MemoryUsage usage = getContainerMemory(values.values);
+    usage += getContainerMemory(values.entityValues);
+    return usage;
+}
+
+void* ECS::getComponentPointer(const ComponentType &componentType, ComponentID componentID) {
+    return static_cast<uint8_t*>(componentType.storage) + componentID * componentType.componentSize;
+}
+
+void* ECS::getColdPointer(const ComponentType &componentType, ComponentID componentID) {
+    return static_cast<uint8_t*>(componentType.coldStorage) + componentID * componentType.coldSize;
+}
+
+// Members of a split component are found in whichever part they were put in
+void* ECS::getMemberPointer(const ComponentType &componentType, ComponentID componentID, const MemberMeta &member) {
+    if (componentType.coldSize > 0 && member.offset >= componentType.coldOffset) {
+        return static_cast<uint8_t*>(getColdPointer(componentType, componentID)) + (member.offset - componentType.coldOffset);
+    }
+
+    return static_cast<uint8_t*>(getComponentPointer(componentType, componentID)) + member.offset;
+}
+
+void ECS::copyComponent(ComponentType &componentType, ComponentID from, ComponentID to) {
+    if (from == to) return;
+
+    memcpy(getComponentPointer(componentType, to), getComponentPointer(componentType, from), componentType.componentSize);
+
+    if (componentType.coldSize > 0) {
+        memcpy(getColdPointer(componentType, to), getColdPointer(componentType, from), componentType.coldSize);
+    }
+}
+
+void ECS::setOwner(ComponentType &componentType, ComponentID componentID, EntityID owner) {
+    uint8_t* componentPtr = static_cast<uint8_t*>(getComponentPointer(componentType, componentID));
+    *reinterpret_cast<EntityID*>(componentPtr + componentType.ownerOffset) = owner;
+}
+
+std::array<double, 3> ECS::getSpatialPosition(const SpatialIndex &spatialIndex, const void *component) {
+    std::array<double, 3> position = {0.0, 0.0, 0.0};
+
+    for (size_t i = 0; i < spatialIndex.axes.size(); i++) {
+        const MemberMeta &axis = spatialIndex.axes[i];
+        position[i] = axis.toNumber(static_cast<const uint8_t*>(component) + axis.offset);
+    }
+
+    return position;
+}
+
+// Packs 21 bits of each cell coordinate into one key, far cells may share a key but never miss
+uint64_t ECS::getSpatialCell(const SpatialIndex &spatialIndex, const std::array<double, 3> &position) {
+    uint64_t cell = 0;
+
+    for (size_t i = 0; i < 3; i++) {
+        int64_t coordinate = (int64_t)std::floor(position[i] / spatialIndex.cellSize);
+        cell |= ((uint64_t)coordinate & 0x1FFFFF) << (21 * i);
+    }
+
+    return cell;
+}
+
+void ECS::insertIntoSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID, const void *component) {
+    uint64_t cell = getSpatialCell(spatialIndex, getSpatialPosition(spatialIndex, component));
+
+    spatialIndex.cells[cell].push_back(entityID);
+    spatialIndex.entityCells[entityID.id] = cell;
+}
+
+void ECS::eraseFromSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID) {
+    auto entityCellIt = spatialIndex.entityCells.find(entityID.id);
+    if (entityCellIt == spatialIndex.entityCells.end()) return;
+
+    std::vector<EntityID> &cell = spatialIndex.cells.at(entityCellIt->second);
+    auto it = std::find(cell.begin(), cell.end(), entityID);
+    *it = cell.back();
+    cell.pop_back();
+
+    if (cell.empty()) {
+        spatialIndex.cells.erase(entityCellIt->second);
+    }
+
+    spatialIndex.entityCells.erase(entityCellIt);
+}
+
+void ECS::moveInSpatialIndex(SpatialIndex &spatialIndex, EntityID from, EntityID to) {
+    auto entityCellIt = spatialIndex.entityCells.find(from.id);
+    if (entityCellIt == spatialIndex.entityCells.end()) return;
+
+    uint64_t cellKey = entityCellIt->second;
+    std::vector<EntityID> &cell = spatialIndex.cells.at(cellKey);
+    *std::find(cell.begin(), cell.end(), from) = to;
+
+    spatialIndex.entityCells.erase(entityCellIt);
+    spatialIndex.entityCells[to.id] = cellKey;
+}
+
+// Only moved when its cell changed
+void ECS::updateInSpatialIndex(SpatialIndex &spatialIndex, EntityID entityID, const void *component) {
+    uint64_t cell = getSpatialCell(spatialIndex, getSpatialPosition(spatialIndex, component));
+    if (spatialIndex.entityCells.at(entityID.id) == cell) return;
+
+    eraseFromSpatialIndex(spatialIndex, entityID);
+    insertIntoSpatialIndex(spatialIndex, entityID, component);
+}
+
+void ECS::refitComponentTypeStorage(ComponentType& componentType, float growthFactor, bool numaAware) {
+    resizeComponentTypeStorage(componentType, std::ceil(componentType.capacity * growthFactor), numaAware);
+}
+
+void ECS::resizeComponentTypeStorage(ComponentType& componentType, size_t newCapacity, bool numaAware) {
+    void* newStorage = new uint8_t[newCapacity * componentType.componentSize];
+
+    if (numaAware && newCapacity * componentType.componentSize >= ECS_NUMA_MIN_POOL_BYTES) {
+        firstTouchByNode(newStorage, componentType.storage, componentType.componentSize * componentType.size, 
+                         newCapacity * componentType.componentSize);
+    } else {
+        memcpy(newStorage, componentType.storage, componentType.componentSize * componentType.size);
+    }
+
+    delete[] static_cast<uint8_t*>(componentType.storage);
+
+    componentType.storage = newStorage;
+
+    if (componentType.coldSize > 0) {
+        void* newColdStorage = new uint8_t[newCapacity * componentType.coldSize];
+        memcpy(newColdStorage, componentType.coldStorage, componentType.coldSize * componentType.size);
+
+        delete[] static_cast<uint8_t*>(componentType.coldStorage);
+        componentType.coldStorage = newColdStorage;
+    }
+
+    componentType.capacity = newCapacity;
+}
+
+ECS &ECS::setNumaAware(bool enabled) {
+    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
 
-    auto componentTypeIt1 = componentTypes.find(typeID1);
-    ECS_WARNING_IF(componentTypeIt1 == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID1)), *this);
+    settings.numaAware = enabled && getNumaTopology().nodeCpus.size() > 1;
 
-    ComponentTypeID typeID2 = typeid(Component2).hash_code();
+    // move the pools that are already big enough onto their nodes
+    if (settings.numaAware) {
+        for (auto &componentType : componentTypes) {
+            if (componentType.second.capacity * componentType.second.componentSize < ECS_NUMA_MIN_POOL_BYTES) continue;
 
-    ECS_WARNING_IF(componentTypes.find(typeID2) == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID2)), *this);
+            refitComponentTypeStorage(componentType.second, 1.0f, true);
+        }
+    }
 
-    ComponentType& componentType1 = componentTypeIt1->second;
+    return *this;
+}
 
-    ECS_WARNING_IF(componentType1.isReadOnly || componentTypes.find(typeID2)->second.isReadOnly, 
-                        COMPONENT_TYPE_IS_READ_ONLY(componentType1.name), *this);
-    ECS_WARNING_IF(componentType1.isLocked || componentTypes.find(typeID2)->second.isLocked, 
-                        COMPONENT_TYPE_IS_LOCKED(componentType1.name), *this);
+size_t ECS::getNumaNodeCount() {
+    return std::max<size_t>(getNumaTopology().nodeCpus.size(), 1);
+}
 
-    Component<Component1>* componentStorage1 = static_cast<Component<Component1>*>(componentType1.storage);
-    size_t totalSize = componentType1.size;
+// Read once from /sys/devices/system/node, e.g. node1/cpulist = "8-15,24-31"
+const ECS::NumaTopology &ECS::getNumaTopology() {
+    static const NumaTopology topology = []() {
+        NumaTopology topology;
 
-    threadCount = std::min(threadCount, totalSize);
+        for (size_t node = 0; ; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) break;
 
-    if(threadCount <= 1){
-        for (size_t i = 0; i < componentType1.size; i++) {
-            EntityID entityID{componentStorage1[i].owner};
+            std::vector<int> cpus;
+            std::string range;
+            while (std::getline(file, range, ',')) {
+                size_t dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
 
-            if((*entities).at(entityID.id).componentIDs.find(typeID2) != (*entities).at(entityID.id).componentIDs.end()) {
-                func(entityID, componentStorage1[i].data, getComponent<Component2>(entityID));
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
             }
+
+            topology.nodeCpus.push_back(cpus);
         }
 
-        return *this;
-    }
+        if (topology.nodeCpus.size() < 2) {
+            topology.nodeCpus.clear();
+        }
 
-    restrict();
+        return topology;
+    }();
 
-    std::vector<std::thread> threads;
-    size_t chunkSize = totalSize / threadCount;
-    size_t remainder = totalSize % threadCount;
+    return topology;
+}
 
-    size_t start = 0;
-    for (size_t i = 0; i < threadCount; i++) {
-        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+// Each node's thread copies and zeroes its own segment, so the kernel places those pages on it
+void ECS::firstTouchByNode(void *destination, const void *source, size_t copyBytes, size_t totalBytes) {
+    const size_t pageSize = 4096;
+    size_t nodeCount = getNumaTopology().nodeCpus.size();
+
+    std::vector<std::thread> threads;
+    for (size_t node = 0; node < nodeCount; node++) {
+        size_t begin = node == 0 ? 0 : (totalBytes * node / nodeCount) / pageSize * pageSize;
+        size_t end = node == nodeCount - 1 ? totalBytes : (totalBytes * (node + 1) / nodeCount) / pageSize * pageSize;
 
         threads.emplace_back([=]() {
-            for (size_t j = start; j < end; j++) {
-                EntityID entityID{componentStorage1[j].owner};
+            bindWorkerToNode(begin, end, totalBytes);
 
-                if((*entities).at(entityID.id).componentIDs.find(typeID2) != (*entities).at(entityID.id).componentIDs.end()) {
-                    func(entityID, componentStorage1[j].data, getComponent<Component2>(entityID));
-                }
-            }
-        });
+            uint8_t *to = static_cast<uint8_t*>(destination);
+            const uint8_t *from = static_cast<const uint8_t*>(source);
+            size_t copyEnd = std::clamp(copyBytes, begin, end);
 
-        start = end;
+            memcpy(to + begin, from + begin, copyEnd - begin);
+            memset(to + copyEnd, 0, end - copyEnd);
+        });
     }
 
-    for (auto& thread : threads) {
+    for (auto &thread : threads) {
         thread.join();
     }
-
-    unrestrict();
-
-    return *this;
 }
 
-template<typename... Components, typename Func, typename ,
-            std::enable_if_t<std::is_invocable_v<Func, Components&...>, long>>
-ECS &ECS::forEach(Func func, size_t threadCount) {
-    // Create a wrapper that adds the EntityID but ignores it when calling `func`
-    auto wrapper = [func](EntityID, Components&... components) {
-        func(components...);
-    };
+// Pins the calling thread to the node owning the middle of [start, end) out of capacity
+void ECS::bindWorkerToNode(size_t start, size_t end, size_t capacity) {
+    const NumaTopology &topology = getNumaTopology();
+    if (topology.nodeCpus.empty() || capacity == 0) return;
+
+    size_t node = std::min((start + end) / 2 * topology.nodeCpus.size() / capacity, topology.nodeCpus.size() - 1);
 
-    // Call the existing forEach function that includes EntityID
-    return forEach<Components...>(wrapper, threadCount);
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : topology.nodeCpus[node]) {
+        CPU_SET(cpu, &cpus);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
 }
 
-template<typename... Components, typename Func, typename ,
-            std::enable_if_t<std::is_invocable_v<Func, EntityID, Components&...>, int>>
-ECS &ECS::forEach(Func func, size_t threadCount) {
+FrameArena &ECS::frameArena() {
+    return *arena;
+}
 
-    std::vector<ComponentTypeID> componentTypesToIterate = {typeid(Components).hash_code()...};
+template <typename T>
+FrameVector<T> ECS::frameVector() {
+    return FrameVector<T>(FrameAllocator<T>(*arena));
+}
 
-    for (size_t i = 0; i < componentTypesToIterate.size(); i++) {
-        ECS_WARNING_IF(componentTypes.find(componentTypesToIterate.at(i)) == componentTypes.end(), 
-                            COMPONENT_TYPE_DOESNT_EXIST(std::to_string(componentTypesToIterate.at(i))), *this);
-        ECS_WARNING_IF(componentTypes.find(componentTypesToIterate.at(i))->second.isReadOnly, 
-                            COMPONENT_TYPE_IS_READ_ONLY(componentTypes.find(componentTypesToIterate.at(i))->second.name), *this);
-        ECS_WARNING_IF(componentTypes.find(componentTypesToIterate.at(i))->second.isLocked, 
-                            COMPONENT_TYPE_IS_LOCKED(componentTypes.find(componentTypesToIterate.at(i))->second.name), *this);
+template <typename T, size_t InlineCount>
+std::span<T> ECS::blob(BlobArray<T, InlineCount> &array) {
+    if (array.header.handle == UINT32_MAX) {
+        return {reinterpret_cast<T*>(array.inlineData), array.header.count};
     }
+    return {reinterpret_cast<T*>(blobs->bytes.data() + blobs->slots[array.header.handle].offset), array.header.count};
+}
 
-    using TypeToUse = typename std::tuple_element<0, std::tuple<Components...>>;
-
-    ComponentType &componentTypeToUse = componentTypes.at(componentTypesToIterate.at(0));
-
-    Component<TypeToUse>* componentTypeToUseStorage = static_cast<Component<TypeToUse>*>(componentTypeToUse.storage);
-    size_t totalSize = componentTypeToUse.size;
+template <typename T, size_t InlineCount>
+std::span<const T> ECS::readBlob(const BlobArray<T, InlineCount> &array) const {
+    if (array.header.handle == UINT32_MAX) {
+        return {reinterpret_cast<const T*>(array.inlineData), array.header.count};
+    }
+    return {reinterpret_cast<const T*>(blobs->bytes.data() + blobs->slots[array.header.handle].offset), array.header.count};
+}
 
-    threadCount = std::min(threadCount, totalSize);
-    
-    if(threadCount <= 1){
-        for (size_t i = 0; i < componentTypeToUse.size; i++) {
-            EntityID entityID = componentTypeToUseStorage[i].owner;
-
-            bool hasAllComponents = true;
-            for (size_t j = 0; j < componentTypesToIterate.size(); j++) {
-                ComponentTypeID typeID = componentTypesToIterate.at(j);
-                if ((*entities).at(entityID.id).componentIDs.find(typeID) == (*entities).at(entityID.id).componentIDs.end()) {
-                    hasAllComponents = false;
-                    break;
-                }
-            }
+// Growing doubles the capacity, so appending one element at a time moves the payload a 
+// logarithmic number of times. Shrinking keeps the slot.
+template <typename T, size_t InlineCount>
+ECS &ECS::resizeBlob(BlobArray<T, InlineCount> &array, size_t count) {
+    bool isInline = array.header.handle == UINT32_MAX;
+    size_t capacity = isInline ? InlineCount : blobs->slots[array.header.handle].capacity / sizeof(T);
 
-            if (hasAllComponents) {
-                std::tuple<Components&...> components = getComponents<Components...>(entityID);
+    if (count > capacity) {
+        // the store is shared with the children, only the root may grow it
+        ECS_REFUSE_IF(restricted, ECS_IS_RESTRICTED, *this);
 
-                auto extendedTuple = std::tuple_cat(std::make_tuple(entityID), components);
+        // allocating may move the store, the old payload is only looked up afterwards
+        uint32_t handle = allocateBlob(std::max(count, 2 * capacity) * sizeof(T));
+        std::span<T> elements = blob(array);
+        memcpy(blobs->bytes.data() + blobs->slots[handle].offset, elements.data(), elements.size_bytes());
 
-                std::apply(func, extendedTuple);
-            }
+        if (!isInline) {
+            releaseBlob(array.header);
         }
-
-        return *this;
+        array.header.handle = handle;
     }
 
-    restrict();
-
-    std::vector<std::thread> threads;
-    size_t chunkSize = totalSize / threadCount;
-    size_t remainder = totalSize % threadCount;
-    
-    size_t start = 0;
-    for (size_t i = 0; i < threadCount; i++) {
-        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+    array.header.count = static_cast<uint32_t>(count);
+    return *this;
+}
 
-        threads.emplace_back([=]() {
-            for (size_t j = start; j < end; j++) {
-                EntityID entityID = componentTypeToUseStorage[j].owner;
-
-                bool hasAllComponents = true;
-                for (size_t k = 0; k < componentTypesToIterate.size(); k++) {
-                    ComponentTypeID typeID = componentTypesToIterate.at(k);
-                    if ((*entities).at(entityID.id).componentIDs.find(typeID) == (*entities).at(entityID.id).componentIDs.end()) {
-                        hasAllComponents = false;
-                        break;
-                    }
-                }
+template <typename T, size_t InlineCount>
+ECS &ECS::assignBlob(BlobArray<T, InlineCount> &array, std::span<const T> values) {
+    resizeBlob(array, values.size());
 
-                if (hasAllComponents) {
-                    std::tuple<Components&...> components = getComponents<Components...>(entityID);
+    std::span<T> elements = blob(array);
+    if (!values.empty() && elements.size() == values.size()) {
+        memcpy(elements.data(), values.data(), values.size_bytes());
+    }
+    return *this;
+}
 
-                    auto extendedTuple = std::tuple_cat(std::make_tuple(entityID), components);
+// Gives the slot back and empties the array
+template <typename T, size_t InlineCount>
+ECS &ECS::releaseBlob(BlobArray<T, InlineCount> &array) {
+    ECS_REFUSE_IF(restricted, ECS_IS_RESTRICTED, *this);
 
-                    std::apply(func, extendedTuple);
-                }
-            }
-        });
+    releaseBlob(array.header);
+    return *this;
+}
 
-        start = end;
+// Slots that are already free are left alone
+void ECS::releaseBlob(BlobHeader &header) {
+    if (header.handle != UINT32_MAX && blobs->slots[header.handle].capacity > 0) {
+        BlobStore::Slot &slot = blobs->slots[header.handle];
+        blobs->wastedBytes += slot.capacity;
+        slot.capacity = 0;
+        blobs->freeHandles.push_back(header.handle);
     }
 
-    for (auto& thread : threads) {
-        thread.join();
-    }
+    header = BlobHeader{};
+}
 
-    unrestrict();
+void ECS::releaseBlobs(ComponentType &componentType, ComponentID componentID) {
+    if (!componentType.hasBlobs) return;
 
-    return *this;
+    for (const auto &member : componentType.members) {
+        if (!member.second.isBlob) continue;
+        releaseBlob(*static_cast<BlobHeader*>(getMemberPointer(componentType, componentID, member.second)));
+    }
 }
 
-SystemBatchID ECS::addSystemBatch() {
-    ECS_ERROR_IF(restricted, ECS_IS_RESTRICTED);
+// Same as releaseBlobs, for a whole component outside of the pool
+void ECS::releaseDetachedBlobs(const ComponentType &componentType, void *component) {
+    if (!componentType.hasBlobs) return;
 
-    SystemBatchID id = generateSystemBatchID();
-    systemBatches[id] = SystemBatch();
-    return id;
-};
+    for (const auto &member : componentType.members) {
+        if (!member.second.isBlob) continue;
+        releaseBlob(*reinterpret_cast<BlobHeader*>(static_cast<uint8_t*>(component) + member.second.offset));
+    }
+}
 
-template <typename... Components>
-ECS &ECS::addSystem(SystemBatchID batchID, std::function<void(ECS&)> func) {
+// Gives a component that was just added its own copy of every payload, the handles it came with 
+// still belong to the component it was copied from
+void ECS::copyBlobs(ComponentType &componentType, ComponentID componentID) {
+    if (!componentType.hasBlobs) return;
 
-    auto systemBatchIt = systemBatches.find(batchID);
-    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(batchID)), *this);
+    for (const auto &member : componentType.members) {
+        if (!member.second.isBlob) continue;
 
-    SystemBatch& systemBatch = systemBatchIt->second;
+        BlobHeader &header = *static_cast<BlobHeader*>(getMemberPointer(componentType, componentID, member.second));
+        if (header.handle == UINT32_MAX) continue;
 
-    std::vector<ComponentTypeID> componentTypeIDs = {typeid(Components).hash_code()...};
+        size_t bytes = blobs->slots[header.handle].capacity;
+        if (bytes == 0) {
+            header = BlobHeader{}; // its payload was already released
+            continue;
+        }
 
-    if(componentTypeIDs.size() == 0){
-        componentTypeIDs = getAllComponentTypeIDs();
+        // allocating may move the store, the source is only looked up afterwards
+        uint32_t handle = allocateBlob(bytes);
+        memcpy(blobs->bytes.data() + blobs->slots[handle].offset, blobs->bytes.data() + blobs->slots[header.handle].offset, bytes);
+        header.handle = handle;
     }
+}
 
-    for(size_t i = 0; i < componentTypeIDs.size(); i++){
-        ECS_WARNING_IF(componentTypes.find(componentTypeIDs[i]) == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(componentTypeIDs[i])), *this);
+// Payloads are appended at the end of the store, once most of it is garbage it is compacted first
+uint32_t ECS::allocateBlob(size_t bytes) {
+    if (blobs->wastedBytes > 0 && blobs->wastedBytes >= blobs->bytes.size() / 2) {
+        compactBlobs();
     }
 
-    for(size_t j = 0; j < systemBatch.parallelSystems.size(); j++){
-        std::vector<ComponentTypeID> parallelSystemComponentIDs = getParallelSystemComponentIDs(batchID, j);
+    const size_t alignment = alignof(std::max_align_t);
+    size_t offset = (blobs->bytes.size() + alignment - 1) / alignment * alignment;
+    blobs->bytes.resize(offset + bytes);
+
+    uint32_t handle;
+    if (blobs->freeHandles.empty()) {
+        handle = static_cast<uint32_t>(blobs->slots.size());
+        blobs->slots.emplace_back();
+    } else {
+        handle = blobs->freeHandles.back();
+        blobs->freeHandles.pop_back();
+    }
 
-        if(!haveCommonElements(parallelSystemComponentIDs, componentTypeIDs)){
-            systemBatch.parallelSystems.at(j).push_back({componentTypeIDs, func});
+    blobs->slots[handle] = {offset, bytes};
+    return handle;
+}
 
-            return *this;
+// Moves the live payloads together in their current order, handles stay the same
+ECS &ECS::compactBlobs() {
+    ECS_REFUSE_IF(restricted, ECS_IS_RESTRICTED, *this);
+
+    std::vector<uint32_t> order;
+    for (uint32_t handle = 0; handle < blobs->slots.size(); handle++) {
+        if (blobs->slots[handle].capacity > 0) {
+            order.push_back(handle);
         }
     }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return blobs->slots[a].offset < blobs->slots[b].offset;
+    });
+
+    const size_t alignment = alignof(std::max_align_t);
+    std::vector<uint8_t> bytes;
+    bytes.reserve(blobs->bytes.size() - blobs->wastedBytes + order.size() * alignment);
+
+    for (uint32_t handle : order) {
+        BlobStore::Slot &slot = blobs->slots[handle];
+        size_t offset = (bytes.size() + alignment - 1) / alignment * alignment;
+        bytes.resize(offset + slot.capacity);
+        memcpy(bytes.data() + offset, blobs->bytes.data() + slot.offset, slot.capacity);
+        slot.offset = offset;
+    }
 
-    systemBatch.parallelSystems.push_back({{componentTypeIDs, func}});
-
+    blobs->bytes.swap(bytes);
+    blobs->wastedBytes = 0;
     return *this;
 }
 
-template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(T&)> func){
-    auto newFunc = [func](ECS&, EntityID, T& component) {
-        func(component);
-    };
-
-    return addSystem<T>(systemType, newFunc);
+FrameArena::~FrameArena() {
+    for (Block &block : blocks) {
+        delete[] block.data;
+    }
 }
-template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(EntityID, T&)> func){
-    auto newFunc = [func](ECS&, EntityID entityID, T& component) {
-        func(entityID, component);
-    };
 
-    return addSystem<T>(systemType, newFunc);
-}
+// Blocks are filled in order, a request that doesn't fit moves on to the next block, which is
+// only allocated the first time the arena gets that far
+void *FrameArena::allocate(size_t bytes, size_t alignment) {
+    for (; block < blocks.size(); block++, offset = 0) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(blocks[block].data);
+        uintptr_t aligned = (start + offset + alignment - 1) / alignment * alignment;
 
-template <typename T> ECS &ECS::addSystem(uint8_t systemType, std::function<void(ECS&, EntityID, T&)> func){
-    ComponentTypeID typeID = typeid(T).hash_code();
+        if (aligned + bytes <= start + blocks[block].size) {
+            offset = aligned + bytes - start;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
 
-    ECS_WARNING_IF(restricted, ECS_IS_RESTRICTED, *this);
-    ECS_WARNING_IF(componentTypes.find(typeID) == componentTypes.end(), COMPONENT_TYPE_DOESNT_EXIST(std::to_string(typeID)), *this);
-    ECS_WARNING_IF(componentTypes.find(typeID)->second.isReadOnly, COMPONENT_TYPE_IS_READ_ONLY(componentTypes.find(typeID)->second.name), *this);
-    ECS_WARNING_IF(componentTypes.find(typeID)->second.isLocked, COMPONENT_TYPE_IS_LOCKED(componentTypes.find(typeID)->second.name), *this);
+    size_t size = std::max<size_t>(ECS_FRAME_ARENA_BLOCK_SIZE, bytes + alignment);
+    blocks.push_back({new uint8_t[size], size});
+    block = blocks.size() - 1;
+    offset = 0;
 
-    if(systemType == SYSTEM_ADD_COMPONENT){
-        auto newFunc = [func](ECS& ecs, EntityID entityID) {
-            T& component = ecs.getComponent<T>(entityID);
-            func(ecs, entityID, component);
-        };
-        addComponentSystems.insert({typeID, newFunc});
-    } else if(systemType == SYSTEM_REMOVE_COMPONENT){
-        auto newFunc = [func](ECS& ecs, EntityID entityID) {
-            T& component = ecs.getComponent<T>(entityID);
-            func(ecs, entityID, component);
-        };
-        removeComponentSystems.insert({typeID, newFunc});
-    } else{
-        ECS_WARNING_IF(true, INVALID_SYSTEM_TYPE, *this);
-    }
+    return allocate(bytes, alignment);
+}
 
-    return *this;
+// Everything allocated after the marker was taken is given back
+void FrameArena::rewind(Marker marker) {
+    block = marker.block;
+    offset = marker.offset;
 }
 
-ECS &ECS::runSystemBatch(SystemBatchID id){
-    auto systemBatchIt = systemBatches.find(id);
-    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(id)), *this);
+size_t FrameArena::reserved() const {
+    size_t bytes = 0;
+    for (const Block &block : blocks) {
+        bytes += block.size;
+    }
+    return bytes;
+}
 
-    SystemBatch &systemBatch = systemBatchIt->second;
+// Walks every part of the world once, so it is meant for diagnostics rather than every frame
+MemoryReport ECS::memoryReport() const {
+    MemoryReport report;
 
-    for(size_t i = 0; i < systemBatch.parallelSystems.size(); i++){
-        std::vector<System> &parallelSystem = systemBatch.parallelSystems.at(i);
+    for (const auto &[typeID, componentType] : componentTypes) {
+        ComponentTypeMemory memory{.name = componentType.name};
 
-        std::vector<std::thread> threads;
-        std::vector<ECS> ecss;
+        size_t stride = componentType.componentSize + componentType.coldSize;
+        memory.pool = {componentType.size * stride, componentType.capacity * stride};
 
-        for(size_t j = 0; j < parallelSystem.size(); j++){
-            ecss.push_back(split(parallelSystem.at(j).componentTypeIDs));
-        }
+        if (componentType.spatialIndex != nullptr) {
+            const SpatialIndex &spatialIndex = *componentType.spatialIndex;
+            memory.indexes += getContainerMemory(spatialIndex.cells);
+            memory.indexes += getContainerMemory(spatialIndex.entityCells);
 
-        for(size_t j = 0; j < parallelSystem.size(); j++){
-            System &system = parallelSystem.at(j);
+            for (const auto &cell : spatialIndex.cells) {
+                memory.indexes += getContainerMemory(cell.second);
+            }
+        }
 
-            ECS &splitECS = ecss.at(j);
+        for (const auto &memberIndex : componentType.memberIndexes) {
+            memory.indexes += memberIndex.second->memoryUsage(*memberIndex.second);
+        }
 
-            threads.emplace_back([&system, &splitECS]() {
-                system.func(splitECS);
-            });
+        if (componentType.indexChanges != nullptr) {
+            memory.indexes += getContainerMemory(componentType.indexChanges->entities);
         }
 
-        for(auto &thread : threads){
-            thread.join();
+        if (componentType.bufferedStorage != nullptr) {
+            for (const ComponentBuffer &buffer : componentType.bufferedStorage->buffers) {
+                memory.buffers += {buffer.size * componentType.componentSize, buffer.capacity * componentType.componentSize};
+            }
         }
 
-        killChildren();
+        report.total += memory.pool;
+        report.total += memory.indexes;
+        report.total += memory.buffers;
+        report.componentTypes.push_back(memory);
     }
 
-    return *this;
-}
+    std::sort(report.componentTypes.begin(), report.componentTypes.end(), [](const ComponentTypeMemory &a, const ComponentTypeMemory &b) {
+        return a.pool.reserved > b.pool.reserved;
+    });
 
-std::vector<ComponentTypeID> ECS::getAllComponentTypeIDs() {
-    std::vector<ComponentTypeID> componentTypeIDs;
+    report.entities = getContainerMemory(*entities);
+    report.guidMap = getContainerMemory(*entitiesMap);
 
-    for (const auto& componentTypeID : componentTypes) {
-        componentTypeIDs.push_back(componentTypeID.first);
+    for (const Entity &entity : *entities) {
+        report.componentMaps += getContainerMemory(entity.componentIDs);
+        report.hierarchy += getContainerMemory(entity.childrenGUIDs);
     }
 
-    return componentTypeIDs;
-}
-
-std::vector<ComponentTypeID> ECS::getParallelSystemComponentIDs(SystemBatchID id, size_t index){
-    std::vector<ComponentTypeID> componentTypeIDs;
+    // a slot holds data while it is claimed
+    report.reservations = getContainerMemory(reservations->slots);
+    report.reservations.used = std::min(reservations->reserved.load(), reservations->slots.size()) * sizeof(ReservedEntity);
+    for (const ReservedEntity &slot : reservations->slots) {
+        report.reservations += getContainerMemory(slot.components);
+    }
 
-    auto systemBatchIt = systemBatches.find(id);
-    ECS_WARNING_IF(systemBatchIt == systemBatches.end(), SYSTEM_BATCH_DOESNT_EXIST(std::to_string(id)), componentTypeIDs);
+    report.systemBatches = getContainerMemory(systemBatches);
+    for (const auto &systemBatch : systemBatches) {
+        report.systemBatches += getContainerMemory(systemBatch.second.parallelSystems);
 
-    SystemBatch &systemBatch = systemBatchIt->second;
+        for (const auto &systems : systemBatch.second.parallelSystems) {
+            report.systemBatches += getContainerMemory(systems);
 
-    std::vector<System> &parallelSystem = systemBatch.parallelSystems.at(index);
+            for (const System &system : systems) {
+                report.systemBatches += getContainerMemory(system.componentTypeIDs);
+            }
+        }
+    }
 
-    for(size_t i = 0; i < parallelSystem.size(); i++){
-        System &system = parallelSystem.at(i);
+    report.observers = getContainerMemory(observers);
+    for (const auto &typeObservers : observers) {
+        const ComponentObservers &componentObservers = typeObservers.second;
+        report.observers += getContainerMemory(componentObservers.onAdd);
+        report.observers += getContainerMemory(componentObservers.onRemove);
+        report.observers += getContainerMemory(componentObservers.onAddBatch);
+        report.observers += getContainerMemory(componentObservers.onRemoveBatch);
+        report.observers += getContainerMemory(componentObservers.added);
+        report.observers += getContainerMemory(componentObservers.removed);
+    }
 
-        for(size_t j = 0; j < system.componentTypeIDs.size(); j++){
-            componentTypeIDs.push_back(parallelSystem.at(i).componentTypeIDs.at(j));
-        }
+    report.resources = getContainerMemory(resources);
+    for (const Resource &resource : resources) {
+        report.resources += {resource.size, resource.size};
     }
 
-    return componentTypeIDs;
-}
+    for (const EventChannel *channel : eventChannels) {
+        if (channel == nullptr) continue;
 
-bool ECS::haveCommonElements(const std::vector<ComponentTypeID>& vec1, const std::vector<ComponentTypeID>& vec2) {
-    for (ComponentTypeID id1 : vec1) {
-        for (ComponentTypeID id2 : vec2) {
-            if (id1 == id2) {
-                return true; // Found a common element
-            }
+        for (const EventBuffer *buffer : {&channel->previous, &channel->current}) {
+            report.events += {buffer->size * channel->eventSize, buffer->capacity * channel->eventSize};
         }
     }
 
-    return false; // No common elements
-}
-
-void ECS::refitComponentTypeStorage(ComponentType& componentType, float growthFactor) {
-    size_t newCapacity = std::ceil(componentType.capacity * growthFactor);
-    void* newStorage = new uint8_t[newCapacity * componentType.componentSize];
+    // released slots are garbage until compactBlobs
+    report.blobs = getContainerMemory(blobs->slots);
+    report.blobs += {blobs->bytes.size() - blobs->wastedBytes, blobs->bytes.capacity()};
 
-    memcpy(newStorage, componentType.storage, componentType.componentSize * componentType.size);
+    for (const MemoryUsage &usage : {report.entities, report.componentMaps, report.guidMap, report.hierarchy, report.reservations,
+                                     report.systemBatches, report.observers, report.resources, report.events, report.blobs}) {
+        report.total += usage;
+    }
 
-    delete[] static_cast<uint8_t*>(componentType.storage);
+    return report;
+}
 
-    componentType.storage = newStorage;
-    componentType.capacity = newCapacity;
+// Vectors report their size against their capacity. Node based containers count one node per 
+// element (the value plus the links the standard library implementations keep), hashed ones 
+// also their bucket array.
+template <typename Container>
+MemoryUsage ECS::getContainerMemory(const Container &container) {
+    using Value = typename Container::value_type;
+
+    if constexpr (requires { container.capacity(); }) {
+        return {container.size() * sizeof(Value), container.capacity() * sizeof(Value)};
+    } else if constexpr (requires { container.bucket_count(); }) {
+        size_t nodes = container.size() * (sizeof(Value) + 2 * sizeof(void*));
+        return {nodes, nodes + container.bucket_count() * sizeof(void*)};
+    } else {
+        size_t nodes = container.size() * (sizeof(Value) + 4 * sizeof(void*));
+        return {nodes, nodes};
+    }
 }
 
+// 64 random bits, so bulk spawning doesn't run into collisions. Each thread has its own 
+// generator since reserveEntity can be called from workers.
 EntityGUID ECS::generateGUID() {
-    std::random_device rd;
-    return EntityGUID{rd()};
+    thread_local std::mt19937_64 generator(std::random_device{}());
+
+    EntityGUID guid{generator()};
+    while (guid.id == 0) {
+        guid.id = generator();
+    }
+
+    return guid;
 }
 
 SystemBatchID ECS::generateSystemBatchID() {
@@ -1357,32 +5105,40 @@ ECS &ECS::terminate() {
     }
 
     for (int i = componentTypesToRemove.size() - 1; i >= 0; i--) {
-        componentTypes.at(componentTypesToRemove.at(i)).removeComponentTypeFunc(*this);
+        removeComponentType(componentTypesToRemove.at(i));
+    }
+
+    for (auto& resource : resources) {
+        if (resource.data != nullptr) {
+            resource.destroyFunc(resource.data);
+        }
     }
+    resources.clear();
+
+    for (EventChannel *channel : eventChannels) {
+        if (channel == nullptr) continue;
+
+        channel->destroyFunc(channel->previous);
+        channel->destroyFunc(channel->current);
+        delete[] static_cast<uint8_t*>(channel->previous.storage);
+        delete[] static_cast<uint8_t*>(channel->current.storage);
+        delete channel;
+    }
+    eventChannels.clear();
 
     return *this;
 }
 
 ECS &ECS::restrict() {
-    restricted = true;
+    restricted.depth.fetch_add(1, std::memory_order_acq_rel);
     return *this;
 }
 
 ECS &ECS::unrestrict() {
-    restricted = false;
+    restricted.depth.fetch_sub(1, std::memory_order_acq_rel);
     return *this;
 }
 
-template <typename T>
-void ECS::removeComponentType_(ECS &ecs) {
-    ecs.removeComponentType<T>();
-}
-
-template <typename T>
-void ECS::removeComponent_(EntityID id, ECS &ecs) {
-    ecs.removeComponent<T>(id);
-}
-
 bool ECS::warnIf(bool condition, const std::string& message, const char* func){
     if (condition) {
         std::clog << "ECS WARNING: " << message;
@@ -1461,6 +5217,16 @@ std::string ECS::toString(void* data, ECS &ecs, int arraySize){
         result += "]";
         return result;
     }
+    else if constexpr (is_blob_array<T>::value) {
+        std::string result = "[";
+        std::span<const typename T::value_type> elements = ecs.readBlob(value);
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (i > 0) result += ", ";
+            result += toString<typename T::value_type>((void*)&elements[i], ecs);
+        }
+        result += "]";
+        return result;
+    }
     else if constexpr (is_unordered_map<T>::value) {
         std::string result = "{";
         bool first = true;
@@ -1493,28 +5259,48 @@ std::string ECS::toString(void* data, ECS &ecs, int arraySize){
         result += "]";
         return result;
     }
-    else if (componentTypeIt != ecs.componentTypes.end()) {
-        ComponentType& componentType = componentTypeIt->second;
+    else if constexpr (has_member_descriptors<T>::value) {
         std::string result = "{";
-
         bool first = true;
-        for (auto memberPair : componentType.members) {
-            const MemberMeta& member = memberPair.second;
-            if (!first) {
-                result += ", ";
-            }
-            first = false;
-            std::string memberName = memberPair.first;
-            void* memberPtr = reinterpret_cast<uint8_t*>(data) + member.offset;
-            std::string memberValue = member.toString(memberPtr, ecs, member.arraySize);
-            result += memberName + ": " + memberValue;
+
+        std::apply([&](const auto&... descriptors) {
+            auto append = [&](const auto &descriptor) {
+                using M = typename std::remove_cvref_t<decltype(descriptor)>::Type;
+                if (!first) result += ", ";
+                first = false;
+                result += std::string(descriptor.name) + ": " + toString<M>((void*)&(value.*descriptor.pointer), ecs, descriptor.arraySize);
+            };
+            (append(descriptors), ...);
+        }, T::members);
+
+        return result + "}";
+    }
+    else if (componentTypeIt != ecs.componentTypes.end()) {
+        return componentToString(componentTypeIt->second, data, ecs);
+    }
+    else {
+        return "Unknown type";
+    }
+}
+
+// Registered components are written member by member, which is all runtime types have
+std::string ECS::componentToString(ComponentType &componentType, void *data, ECS &ecs) {
+    std::string result = "{";
+
+    bool first = true;
+    for (auto memberPair : componentType.members) {
+        const MemberMeta& member = memberPair.second;
+        if (!first) {
+            result += ", ";
         }
-        result += "}";
-        return result;
-    }
-    else {
-        return "Unknown type";
+        first = false;
+        std::string memberName = memberPair.first;
+        void* memberPtr = reinterpret_cast<uint8_t*>(data) + member.offset;
+        std::string memberValue = member.toString(memberPtr, ecs, member.arraySize);
+        result += memberName + ": " + memberValue;
     }
+    result += "}";
+    return result;
 }
 
 std::string ECS::toString(EntityGUID guid){
@@ -1545,7 +5331,17 @@ std::string ECS::toString(EntityID entityID, EntityGUID parentGUID, std::vector<
 
         ComponentType &componentType = componentTypes.at(typeID);
 
-        std::string componentString = componentType.toString(componentPtr, *this, 0);
+        // a split component is put back together so its cold members are written too
+        std::vector<uint8_t> wholeComponent;
+        if (componentType.coldSize > 0) {
+            wholeComponent.resize(componentType.coldOffset + componentType.coldSize);
+            memcpy(wholeComponent.data(), componentPtr, componentType.coldOffset);
+            memcpy(wholeComponent.data() + componentType.coldOffset, getColdPointer(componentType, componentID.second), componentType.coldSize);
+            componentPtr = wholeComponent.data();
+        }
+
+        std::string componentString = componentType.toString != nullptr ? componentType.toString(componentPtr, *this, 0)
+                                                                         : componentToString(componentType, componentPtr, *this);
         result += componentType.name + ": " + componentString;
     }
 
@@ -1631,12 +5427,18 @@ void ECS::fromString(EntityID id, std::string str, std::unordered_map<EntityGUID
 
         ComponentTypeID typeID = componentTypeNames.at(keyStr);
 
-        uint8_t* componentPtr = new uint8_t[componentTypes.at(typeID).componentSize];
+        ComponentType &componentType = componentTypes.at(typeID);
+        uint8_t* componentPtr = new uint8_t[componentType.componentSize + componentType.coldSize]();
 
-        componentTypes.at(typeID).fromString((void*)componentPtr, valStr, *this, 0);
+        if (componentType.fromString != nullptr) {
+            componentType.fromString((void*)componentPtr, valStr, *this, 0);
+        } else {
+            componentFromString(typeID, (void*)componentPtr, valStr, *this);
+        }
 
         addComponent(id, typeID, (void*)componentPtr);
-        
+
+        releaseDetachedBlobs(componentType, componentPtr); // the added component has its own copies
         delete[] componentPtr;
     }
 }
@@ -1852,6 +5654,24 @@ void ECS::fromString(void* ptr, std::string str, ECS &ecs, int arraySize) {
             fromString<Elem>(&value.emplace_back(), token, ecs);
         }
     }
+    else if constexpr (is_blob_array<T>::value) {
+        using Elem = typename T::value_type;
+        value = T{}; // the target may be uninitialized, never release what it holds
+
+        str = str.substr(1, str.size() - 2);
+        std::vector<std::string> sections = splitTopLevelCommaSections(str);
+        std::vector<Elem> elements;
+
+        for(const auto& section : sections) {
+            std::string token = section;
+            token.erase(remove_if(token.begin(), token.end(), ::isspace), token.end()); // Trim spaces
+            if (token.empty()) continue;
+
+            fromString<Elem>(&elements.emplace_back(), token, ecs);
+        }
+
+        ecs.assignBlob(value, std::span<const Elem>(elements));
+    }
     else if constexpr (is_unordered_map<T>::value) {
         using Key = typename T::key_type;
         using Val = typename T::mapped_type;
@@ -1912,34 +5732,526 @@ void ECS::fromString(void* ptr, std::string str, ECS &ecs, int arraySize) {
             }
         }
     }
+    else if constexpr (has_member_descriptors<T>::value) {
+        str = str.substr(1, str.size() - 2); // Remove brackets
+
+        std::vector<std::string> sections = splitTopLevelCommaSections(str);
+        for (const auto& section : sections) {
+            auto colon = section.find(':');
+            if (colon == std::string::npos) continue;
+            std::string keyStr = section.substr(0, colon);
+            std::string valStr = section.substr(colon + 1);
+            keyStr.erase(remove_if(keyStr.begin(), keyStr.end(), ::isspace), keyStr.end());
+            valStr.erase(0, valStr.find_first_not_of(" \t"));
+
+            bool found = std::apply([&](const auto&... descriptors) {
+                auto read = [&](const auto &descriptor) {
+                    using M = typename std::remove_cvref_t<decltype(descriptor)>::Type;
+                    if (keyStr != descriptor.name) return false;
+                    fromString<M>(&(value.*descriptor.pointer), valStr, ecs, descriptor.arraySize);
+                    return true;
+                };
+                return (read(descriptors) || ...);
+            }, T::members);
+
+            ECS_WARNING_IF(!found, MEMBER_DOESNT_EXIST(keyStr), );
+        }
+    }
     else {
         ComponentTypeID typeID = typeid(T).hash_code();
-        auto componentTypeIt = ecs.componentTypes.find(typeID);
 
-        if (componentTypeIt != ecs.componentTypes.end()) {
-            str = str.substr(1, str.size() - 2); // Remove brackets
+        if (ecs.componentTypes.find(typeID) != ecs.componentTypes.end()) {
+            componentFromString(typeID, ptr, str, ecs);
+        } else {
+            ECS_WARNING_IF(true, "Unknown type", );
+        }
+    }
+}
+
+void ECS::componentFromString(ComponentTypeID typeID, void *data, std::string str, ECS &ecs) {
+    str = str.substr(1, str.size() - 2); // Remove brackets
+
+    std::vector<std::string> sections = splitTopLevelCommaSections(str);
+    for (const auto& section : sections) {
+        auto colon = section.find(':');
+        if (colon == std::string::npos) continue;
+        std::string keyStr = section.substr(0, colon);
+        std::string valStr = section.substr(colon + 1);
+        keyStr.erase(remove_if(keyStr.begin(), keyStr.end(), ::isspace), keyStr.end());
+        valStr.erase(0, valStr.find_first_not_of(" \t"));
+
+        MemberMeta memberMeta = ecs.getMemberMeta(keyStr, typeID);
+
+        ECS_WARNING_IF(memberMeta.size == 0, MEMBER_DOESNT_EXIST(keyStr), );
+
+        uint8_t* memberPtr = reinterpret_cast<uint8_t*>(data) + memberMeta.offset;
+        memberMeta.fromString(memberPtr, valStr, ecs, memberMeta.arraySize);
+    }
+}
+
+template <typename T>
+double ECS::toNumber(const void* ptr) {
+    return static_cast<double>(*static_cast<const T*>(ptr));
+}
+
+// A world whose component types are all known at compile time. Each type has a typed pool in a
+// tuple and a constexpr index, so lookups are array indexing and queries are built when they 
+// are instantiated. The entity, component and loop API matches ECS so code can be ported by 
+// changing the type of the world. Scheduling, serialization and the other runtime features 
+// stay with ECS.
+template <typename... Components>
+class StaticECS {
+    static_assert(sizeof...(Components) <= ECS_MAX_COMPONENT_TYPES, TOO_MANY_COMPONENT_TYPES);
+
+    using ComponentID = size_t;
+
+    template <typename T>
+    struct Pool {
+        std::vector<T> components;
+        std::vector<EntityID> owners;
+    };
+
+    struct Entity {
+        EntityGUID guid;
+        std::array<ComponentID, sizeof...(Components)> componentIDs; // SIZE_MAX where the component is missing
+        ComponentSignature signature;
+    };
+
+public:
+    // Component types
+    template <typename T> static constexpr ComponentTypeID getComponentTypeID();
+    template <typename... Types> static ComponentSignature getSignature();
+
+    // Entity management
+    StaticECS &addEntity();
+    StaticECS &addEntity(EntityGUID &guid);
+    StaticECS &removeEntity(EntityGUID entityGUID);
+    StaticECS &removeEntity(EntityID entityID);
+    const EntityID getEntityID(EntityGUID entityGUID) const;
+    ComponentSignature getSignature(EntityGUID entityGUID) const;
+    ComponentSignature getSignature(EntityID entityID) const;
+    size_t getEntityCount() const { return entities.size(); }
+
+    // Component management
+    template <typename T, typename... Args> StaticECS &addComponent(Args&&... args);
+    template <typename T, typename... Args> StaticECS &addComponent(EntityGUID entityGUID, Args&&... args);
+    template <typename T, typename... Args> StaticECS &addComponent(EntityID entityID, Args&&... args);
+    template <typename T> StaticECS &removeComponent(EntityGUID entityGUID);
+    template <typename T> StaticECS &removeComponent(EntityID entityID);
+
+    // Component access
+    template <typename T> T &getComponent();
+    template <typename T> T &getComponent(EntityGUID entityGUID);
+    template <typename T> T &getComponent(EntityID entityID);
+    template <typename T> const T &readComponent(EntityGUID entityGUID) const;
+    template <typename T> const T &readComponent(EntityID entityID) const;
+
+    // Looping through components
+    // Takes the same terms (T, With<T>, Without<T>, Optional<T>) and callbacks as ECS::forEach. 
+    // With threadCount > 1 adding or removing entities or components is refused until it returns.
+    template <typename... Terms, typename Func> StaticECS &forEach(Func func, size_t threadCount = 1);
+    template <typename... Terms, typename Result, typename Map, typename Combine>
+    Result forEachReduce(Result init, Map map, Combine combine, size_t threadCount = 1);
+
+private:
+    template <typename T> static constexpr size_t componentIndex();
+    template <typename T> Pool<T> &getPool();
+    template <typename T> const Pool<T> &getPool() const;
+    template <typename T> void removeComponentAt(EntityID entityID);
+    template <typename... Terms> size_t prepareQuery(const std::vector<EntityID> *&driver, 
+                                                     ComponentSignature &required, ComponentSignature &excluded);
+    template <typename... Terms, typename Func> void runQuery(const std::vector<EntityID> *driver, const ComponentSignature &required, 
+                                                              const ComponentSignature &excluded, Func &func, size_t start, size_t end);
+    template <typename Term> auto fetchQueryTerm(const Entity &entity);
+    template <typename Chunk> void runChunks(size_t totalSize, size_t threadCount, Chunk chunk);
+    static bool warnIf(bool condition, const std::string& message, const char* func) { return ECS::warnIf(condition, message, func); }
+    static bool errorIf(bool condition, const std::string& message, const char* func) { return ECS::errorIf(condition, message, func); }
+
+    std::tuple<Pool<Components>...> pools;
+    std::vector<Entity> entities;
+    std::unordered_map<EntityGUID, EntityID> entitiesMap;
+    EntityID cachedEntityID = {SIZE_MAX};
+    std::atomic<int> restricted = 0;
+};
+
+template <typename... Components>
+template <typename T>
+constexpr size_t StaticECS<Components...>::componentIndex() {
+    constexpr std::array<bool, sizeof...(Components)> matches = {std::is_same_v<T, Components>...};
+
+    for (size_t i = 0; i < matches.size(); i++) {
+        if (matches[i]) return i;
+    }
+    return sizeof...(Components);
+}
+
+template <typename... Components>
+template <typename T>
+constexpr ComponentTypeID StaticECS<Components...>::getComponentTypeID() {
+    static_assert(componentIndex<T>() < sizeof...(Components), "Component type is not part of this StaticECS");
+    return componentIndex<T>();
+}
+
+template <typename... Components>
+template <typename... Types>
+ComponentSignature StaticECS<Components...>::getSignature() {
+    ComponentSignature signature;
+    (signature.set(getComponentTypeID<Types>()), ...);
+    return signature;
+}
+
+template <typename... Components>
+template <typename T>
+auto StaticECS<Components...>::getPool() -> Pool<T>& {
+    static_assert(componentIndex<T>() < sizeof...(Components), "Component type is not part of this StaticECS");
+    return std::get<Pool<T>>(pools);
+}
+
+template <typename... Components>
+template <typename T>
+auto StaticECS<Components...>::getPool() const -> const Pool<T>& {
+    static_assert(componentIndex<T>() < sizeof...(Components), "Component type is not part of this StaticECS");
+    return std::get<Pool<T>>(pools);
+}
+
+template <typename... Components>
+StaticECS<Components...> &StaticECS<Components...>::addEntity() {
+    EntityGUID guid;
+    return addEntity(guid);
+}
+
+template <typename... Components>
+StaticECS<Components...> &StaticECS<Components...>::addEntity(EntityGUID &guid) {
+    ECS_WARNING_IF(restricted > 0, ECS_IS_RESTRICTED, *this);
+
+    if(guid.id == 0){
+        guid = ECS::generateGUID();
+    }
+
+    ECS_WARNING_IF(entitiesMap.find(guid) != entitiesMap.end(), ENTITY_GUID_ALREADY_EXISTS(std::to_string(guid.id)), *this);
+
+    Entity &entity = entities.emplace_back(Entity{.guid = guid});
+    entity.componentIDs.fill(SIZE_MAX);
+
+    cachedEntityID = EntityID{entities.size() - 1};
+    entitiesMap[guid] = cachedEntityID;
+    return *this;
+}
+
+template <typename... Components>
+StaticECS<Components...> &StaticECS<Components...>::removeEntity(EntityGUID entityGUID) {
+    return removeEntity(getEntityID(entityGUID));
+}
+
+// Same as ECS::removeEntity, the last entity takes the freed id
+template <typename... Components>
+StaticECS<Components...> &StaticECS<Components...>::removeEntity(EntityID entityID) {
+    ECS_WARNING_IF(restricted > 0, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(entityID.id >= entities.size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), *this);
+
+    (removeComponentAt<Components>(entityID), ...);
+
+    EntityGUID guid = entities[entityID.id].guid;
+    EntityID lastEntityID{entities.size() - 1};
+    entities[entityID.id] = entities[lastEntityID.id];
+    entitiesMap[entities[entityID.id].guid] = entityID;
+    entitiesMap.erase(guid);
+    entities.pop_back();
+
+    // The last entity now lives at entityID, point its components back at it
+    if (entityID.id != lastEntityID.id) {
+        auto setOwner = [this, entityID]<typename T>() {
+            ComponentID componentID = entities[entityID.id].componentIDs[componentIndex<T>()];
+            if (componentID != SIZE_MAX) {
+                getPool<T>().owners[componentID] = entityID;
+            }
+        };
+        (setOwner.template operator()<Components>(), ...);
+    }
+
+    cachedEntityID = entityID;
+    return *this;
+}
+
+template <typename... Components>
+const EntityID StaticECS<Components...>::getEntityID(EntityGUID entityGUID) const {
+    auto entityIt = entitiesMap.find(entityGUID);
+    ECS_WARNING_IF(entityIt == entitiesMap.end(), ENTITY_GUID_DOESNT_EXIST(std::to_string(entityGUID.id)), EntityID{SIZE_MAX});
+
+    return entityIt->second;
+}
+
+template <typename... Components>
+ComponentSignature StaticECS<Components...>::getSignature(EntityGUID entityGUID) const {
+    return getSignature(getEntityID(entityGUID));
+}
+
+template <typename... Components>
+ComponentSignature StaticECS<Components...>::getSignature(EntityID entityID) const {
+    ECS_WARNING_IF(entityID.id >= entities.size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), ComponentSignature{});
+
+    return entities[entityID.id].signature;
+}
+
+template <typename... Components>
+template <typename T, typename... Args>
+StaticECS<Components...> &StaticECS<Components...>::addComponent(Args&&... args) {
+    return addComponent<T>(cachedEntityID, std::forward<Args>(args)...);
+}
+
+template <typename... Components>
+template <typename T, typename... Args>
+StaticECS<Components...> &StaticECS<Components...>::addComponent(EntityGUID entityGUID, Args&&... args) {
+    return addComponent<T>(getEntityID(entityGUID), std::forward<Args>(args)...);
+}
+
+template <typename... Components>
+template <typename T, typename... Args>
+StaticECS<Components...> &StaticECS<Components...>::addComponent(EntityID entityID, Args&&... args) {
+    constexpr size_t index = componentIndex<T>();
+    Pool<T> &pool = getPool<T>();
+
+    ECS_WARNING_IF(restricted > 0, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(entityID.id >= entities.size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), *this);
+
+    Entity &entity = entities[entityID.id];
+    ECS_WARNING_IF(entity.componentIDs[index] != SIZE_MAX, ENTITY_ALREADY_CONTAINS_COMPONENT(std::string(typeid(T).name())), *this);
+
+    entity.componentIDs[index] = pool.components.size();
+    entity.signature.set(index);
+    pool.components.push_back(T{std::forward<Args>(args)...});
+    pool.owners.push_back(entityID);
+
+    return *this;
+}
+
+template <typename... Components>
+template <typename T>
+StaticECS<Components...> &StaticECS<Components...>::removeComponent(EntityGUID entityGUID) {
+    return removeComponent<T>(getEntityID(entityGUID));
+}
+
+template <typename... Components>
+template <typename T>
+StaticECS<Components...> &StaticECS<Components...>::removeComponent(EntityID entityID) {
+    ECS_WARNING_IF(restricted > 0, ECS_IS_RESTRICTED, *this);
+    ECS_WARNING_IF(entityID.id >= entities.size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)), *this);
+    ECS_WARNING_IF(entities[entityID.id].componentIDs[componentIndex<T>()] == SIZE_MAX, 
+                   ENTITY_DOESNT_CONTAIN_COMPONENT(std::string(typeid(T).name())), *this);
+
+    removeComponentAt<T>(entityID);
+    return *this;
+}
+
+// Swaps the last component of the pool into the freed slot, does nothing if the entity has no T
+template <typename... Components>
+template <typename T>
+void StaticECS<Components...>::removeComponentAt(EntityID entityID) {
+    constexpr size_t index = componentIndex<T>();
+    Pool<T> &pool = getPool<T>();
+    Entity &entity = entities[entityID.id];
+
+    ComponentID componentID = entity.componentIDs[index];
+    if (componentID == SIZE_MAX) return;
+
+    ComponentID lastComponentID = pool.components.size() - 1;
+    if (componentID != lastComponentID) {
+        pool.components[componentID] = std::move(pool.components[lastComponentID]);
+        pool.owners[componentID] = pool.owners[lastComponentID];
+        entities[pool.owners[componentID].id].componentIDs[index] = componentID;
+    }
+    pool.components.pop_back();
+    pool.owners.pop_back();
+
+    entity.componentIDs[index] = SIZE_MAX;
+    entity.signature.reset(index);
+}
+
+template <typename... Components>
+template <typename T>
+T &StaticECS<Components...>::getComponent() {
+    return getComponent<T>(cachedEntityID);
+}
+
+template <typename... Components>
+template <typename T>
+T &StaticECS<Components...>::getComponent(EntityGUID entityGUID) {
+    return getComponent<T>(getEntityID(entityGUID));
+}
+
+template <typename... Components>
+template <typename T>
+T &StaticECS<Components...>::getComponent(EntityID entityID) {
+    return const_cast<T&>(readComponent<T>(entityID));
+}
+
+template <typename... Components>
+template <typename T>
+const T &StaticECS<Components...>::readComponent(EntityGUID entityGUID) const {
+    return readComponent<T>(getEntityID(entityGUID));
+}
+
+template <typename... Components>
+template <typename T>
+const T &StaticECS<Components...>::readComponent(EntityID entityID) const {
+    ECS_ERROR_IF(entityID.id >= entities.size(), ENTITY_DOESNT_EXIST(std::to_string(entityID.id)));
+
+    ComponentID componentID = entities[entityID.id].componentIDs[componentIndex<T>()];
+    ECS_ERROR_IF(componentID == SIZE_MAX, ENTITY_DOESNT_CONTAIN_COMPONENT(std::string(typeid(T).name())));
+
+    return getPool<T>().components[componentID];
+}
+
+template <typename... Components>
+template <typename... Terms, typename Func>
+StaticECS<Components...> &StaticECS<Components...>::forEach(Func func, size_t threadCount) {
+    const std::vector<EntityID> *driver = nullptr;
+    ComponentSignature required, excluded;
+    size_t totalSize = prepareQuery<Terms...>(driver, required, excluded);
+    threadCount = std::min(threadCount, totalSize);
+
+    runChunks(totalSize, threadCount, [&](size_t, size_t start, size_t end) {
+        if (threadCount <= 1) {
+            runQuery<Terms...>(driver, required, excluded, func, start, end);
+            return;
+        }
+
+        // like ECS::forEach, each worker gets a copy of the callback
+        Func workerFunc = func;
+        runQuery<Terms...>(driver, required, excluded, workerFunc, start, end);
+    });
+
+    return *this;
+}
+
+// Same contract as ECS::forEachReduce
+template <typename... Components>
+template <typename... Terms, typename Result, typename Map, typename Combine>
+Result StaticECS<Components...>::forEachReduce(Result init, Map map, Combine combine, size_t threadCount) {
+    const std::vector<EntityID> *driver = nullptr;
+    ComponentSignature required, excluded;
+    size_t totalSize = prepareQuery<Terms...>(driver, required, excluded);
 
-            std::vector<std::string> sections = splitTopLevelCommaSections(str);
-            for (const auto& section : sections) {
-                auto colon = section.find(':');
-                if (colon == std::string::npos) continue;
-                std::string keyStr = section.substr(0, colon);
-                std::string valStr = section.substr(colon + 1);
-                keyStr.erase(remove_if(keyStr.begin(), keyStr.end(), ::isspace), keyStr.end());
-                valStr.erase(0, valStr.find_first_not_of(" \t"));
+    threadCount = std::max<size_t>(std::min(threadCount, totalSize), 1);
+    std::vector<Result> partials(threadCount, init);
 
-                MemberMeta memberMeta = ecs.getMemberMeta(keyStr, typeID);
+    runChunks(totalSize, threadCount, [&](size_t chunk, size_t start, size_t end) {
+        Result accumulator = init;
 
-                ECS_WARNING_IF(memberMeta.size == 0, MEMBER_DOESNT_EXIST(keyStr), );
+        auto accumulate = [&accumulator, &map, &combine](EntityID entityID, auto&&... arguments) {
+            if constexpr (std::is_invocable_v<Map&, EntityID, decltype(arguments)...>) {
+                accumulator = combine(std::move(accumulator), map(entityID, std::forward<decltype(arguments)>(arguments)...));
+            } else {
+                accumulator = combine(std::move(accumulator), map(std::forward<decltype(arguments)>(arguments)...));
+            }
+        };
+
+        runQuery<Terms...>(driver, required, excluded, accumulate, start, end);
+        partials[chunk] = std::move(accumulator);
+    });
+
+    Result result = std::move(partials.at(0));
+    for (size_t i = 1; i < partials.size(); i++) {
+        result = combine(std::move(result), std::move(partials[i]));
+    }
+
+    return result;
+}
 
-                uint8_t* memberPtr = reinterpret_cast<uint8_t*>(ptr) + memberMeta.offset;
-                memberMeta.fromString(memberPtr, valStr, ecs, memberMeta.arraySize);
+// Signatures come from the constexpr indices of the terms, only the driver is chosen at runtime:
+// the smallest pool of a required term, or every entity when there is none. Returns how many 
+// entries the driver has.
+template <typename... Components>
+template <typename... Terms>
+size_t StaticECS<Components...>::prepareQuery(const std::vector<EntityID> *&driver, 
+                                              ComponentSignature &required, ComponentSignature &excluded) {
+    auto addTerm = [&]<typename Term>() {
+        using T = typename QueryTerm<Term>::Type;
+        const std::vector<EntityID> &owners = getPool<T>().owners;
+
+        if constexpr (QueryTerm<Term>::isRequired) {
+            required.set(componentIndex<T>());
+
+            if (driver == nullptr || owners.size() < driver->size()) {
+                driver = &owners;
             }
+        } else if constexpr (QueryTerm<Term>::isExcluded) {
+            excluded.set(componentIndex<T>());
+        }
+    };
+    (addTerm.template operator()<Terms>(), ...);
+
+    return driver != nullptr ? driver->size() : entities.size();
+}
+
+template <typename... Components>
+template <typename... Terms, typename Func>
+void StaticECS<Components...>::runQuery(const std::vector<EntityID> *driver, const ComponentSignature &required, 
+                                        const ComponentSignature &excluded, Func &func, size_t start, size_t end) {
+    for (size_t i = start; i < end; i++) {
+        EntityID entityID = driver != nullptr ? (*driver)[i] : EntityID{i};
+        const Entity &entity = entities[entityID.id];
+
+        if ((entity.signature & required) != required || (entity.signature & excluded).any()) {
+            continue;
+        }
+
+        if constexpr (is_query_invocable<Func, QueryArguments<Terms...>, EntityID>::value) {
+            std::apply(func, std::tuple_cat(std::make_tuple(entityID), fetchQueryTerm<Terms>(entity)...));
         } else {
-            ECS_WARNING_IF(true, "Unknown type", );
+            std::apply(func, std::tuple_cat(fetchQueryTerm<Terms>(entity)...));
         }
     }
 }
 
+template <typename... Components>
+template <typename Term>
+auto StaticECS<Components...>::fetchQueryTerm(const Entity &entity) {
+    using T = typename QueryTerm<Term>::Type;
+    ComponentID componentID = entity.componentIDs[componentIndex<T>()];
+
+    if constexpr (!QueryTerm<Term>::isFetched) {
+        return std::tuple<>();
+    } else if constexpr (QueryTerm<Term>::isOptional) {
+        return std::tuple<T*>(componentID == SIZE_MAX ? nullptr : &getPool<T>().components[componentID]);
+    } else {
+        return std::tuple<T&>(getPool<T>().components[componentID]);
+    }
+}
+
+// Splits [0, totalSize) into threadCount chunks and runs `chunk(index, start, end)` on each
+template <typename... Components>
+template <typename Chunk>
+void StaticECS<Components...>::runChunks(size_t totalSize, size_t threadCount, Chunk chunk) {
+    threadCount = std::min(threadCount, totalSize);
+
+    if (threadCount <= 1) {
+        chunk(0, 0, totalSize);
+        return;
+    }
+
+    restricted++;
+
+    std::vector<std::thread> threads;
+    size_t chunkSize = totalSize / threadCount;
+    size_t remainder = totalSize % threadCount;
+
+    size_t start = 0;
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t end = start + chunkSize + (i < remainder ? 1 : 0); // Distribute remainder
+
+        threads.emplace_back([&chunk, i, start, end]() {
+            chunk(i, start, end);
+        });
+
+        start = end;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    restricted--;
+}
 
-} // namespace bbecs
\ No newline at end of file
+} // namespace bbecs
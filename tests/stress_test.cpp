@@ -0,0 +1,348 @@
+// Concurrency stress tests, meant to be run under ThreadSanitizer (configure with -DECS_TSAN=ON)
+
+#include <iostream>
+
+#include "bearBonesECS.hpp"
+
+#define TEST_ECS(x) std::cout << "Running test: " << #x; if(!x()) { std::cerr << " - Failed";  } else { std::cout << " - Passed"; } std::cout << std::endl;
+
+struct Position
+{
+    double x, y;
+};
+
+struct Velocity
+{
+    double x, y;
+};
+
+struct State
+{
+    int state;
+};
+
+struct Gravity
+{
+    double g;
+};
+
+struct Hit
+{
+    int damage;
+};
+
+const size_t entityCount = 10000;
+const size_t threadCount = 8;
+const size_t rounds = 20;
+
+void populate(bbECS::ECS &ecs)
+{
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .addComponentType<State>("State")
+        .insertResource<Gravity>(-10.0);
+
+    for(size_t i = 0; i < entityCount; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>(0.0, 0.0)
+            .addComponent<Velocity>(1.0, (double)i);
+
+        if(i % 1000 == 0)
+        {
+            ecs.addComponent<State>((int)i);
+        }
+    }
+}
+
+// workers read components of other types, signatures and resources while writing their own
+bool testConcurrentReads()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+
+    for(size_t round = 0; round < rounds; round++)
+    {
+        ecs.forEach<Position>([&ecs](bbECS::EntityID id, Position &pos) {
+            const Velocity &vel = ecs.readComponent<Velocity>(id);
+            bbECS::ComponentSignature signature = ecs.getSignature(id);
+
+            if(signature.count() >= 2)
+            {
+                pos.x += vel.x;
+                pos.y += vel.y + ecs.readResource<Gravity>().g;
+            }
+        }, threadCount);
+    }
+
+    bool correct = true;
+    ecs.forEach<Position, Velocity>([&correct](Position &pos, Velocity &vel) {
+        correct = correct && pos.x == rounds && pos.y == rounds * (vel.y - 10.0);
+    });
+
+    if(!correct)
+    {
+        std::cerr << "Error: Concurrent reads not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// workers start their own parallel loops, which restrict and unrestrict the shared ECS
+bool testNestedParallelLoops()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+
+    std::atomic<size_t> visited = 0;
+
+    for(size_t round = 0; round < rounds; round++)
+    {
+        ecs.forEach<State>([&ecs, &visited](State&) {
+            size_t count = ecs.forEachReduce<Velocity>((size_t)0,
+                [](const Velocity&) { return (size_t)1; },
+                [](size_t a, size_t b) { return a + b; }, 2);
+
+            visited += count;
+        }, threadCount);
+    }
+
+    if(visited != rounds * (entityCount / 1000) * entityCount)
+    {
+        std::cerr << "Error: Nested parallel loops not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// workers of parallel loops and of parallel systems send events at the same time
+bool testConcurrentEvents()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+    ecs.addEventType<Hit>(2 * entityCount);
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Position>([&ecs](Position&) {
+            ecs.send<Hit>(1);
+        }, threadCount / 2);
+    });
+
+    ecs.addSystem<Velocity>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Velocity>([&ecs](Velocity&) {
+            ecs.send<Hit>(2);
+        }, threadCount / 2);
+    });
+
+    bbECS::EventCursor cursor;
+
+    for(size_t round = 0; round < rounds; round++)
+    {
+        ecs.runSystemBatch(sbID);
+
+        size_t count = 0, total = 0;
+        ecs.read<Hit>(cursor, [&count, &total](const Hit &hit) {
+            count++;
+            total += hit.damage;
+        });
+
+        if(count != 2 * entityCount || total != 3 * entityCount)
+        {
+            std::cerr << "Error: Concurrent events not correct." << std::endl;
+            return false;
+        }
+
+        ecs.updateEvents();
+    }
+
+    return true;
+}
+
+// workers of parallel systems reserve entities and components at the same time
+bool testConcurrentSpawning()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+    ecs.reserveEntitySlots(2 * entityCount);
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Position>([&ecs](Position&) {
+            ecs.addComponent<State>(ecs.reserveEntity(), 1);
+        }, threadCount / 2);
+    });
+
+    ecs.addSystem<Velocity>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Velocity>([&ecs](Velocity&) {
+            ecs.addComponent<State>(ecs.reserveEntity(), 2);
+        }, threadCount / 2);
+    });
+
+    ecs.runSystemBatch(sbID);
+
+    size_t count = 0, total = 0;
+    ecs.forEach<State>([&count, &total](State &state) {
+        count++;
+        total += state.state;
+    });
+
+    if(count != 2 * entityCount + entityCount / 1000 || total != 3 * entityCount + 45000)
+    {
+        std::cerr << "Error: Concurrent spawning not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// an outside thread reads Position with tokens while the systems write Velocity and then Position
+bool testExternalAccessTokens()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Velocity>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Velocity>([](Velocity &vel) {
+            vel.x += 1.0;
+        }, threadCount);
+    });
+
+    ecs.addSystem<Position, Velocity>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Position, Velocity>([](Position &pos, Velocity &vel) {
+            pos.x = vel.x;
+        }, threadCount);
+    });
+
+    std::atomic<bool> running = true;
+    bool consistent = true;
+
+    std::thread reader([&ecs, &running, &consistent]() {
+        while(running)
+        {
+            bbECS::AccessToken token = ecs.acquireRead<Position>();
+
+            double first = ecs.readComponent<Position>(bbECS::EntityID{0}).x;
+            double last = ecs.readComponent<Position>(bbECS::EntityID{entityCount - 1}).x;
+            consistent = consistent && first == last;
+        }
+    });
+
+    for(size_t round = 0; round < rounds; round++)
+    {
+        ecs.runSystemBatch(sbID);
+    }
+
+    running = false;
+    reader.join();
+
+    if(!consistent || ecs.readComponent<Position>(bbECS::EntityID{0}).x != 1.0 + rounds)
+    {
+        std::cerr << "Error: External access tokens not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// a render thread takes snapshots while the simulation writes and swaps, every snapshot must be whole
+bool testBufferedSnapshots()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+    ecs.setBuffered<Position>(3);
+    ecs.swapBuffers();
+
+    std::atomic<bool> running = true;
+    bool consistent = true;
+    size_t snapshots = 0;
+
+    std::thread renderer([&ecs, &running, &consistent, &snapshots]() {
+        while(running)
+        {
+            bbECS::ComponentSnapshot<Position> snapshot = ecs.snapshot<Position>();
+
+            for(size_t i = 1; i < snapshot.size(); i++)
+            {
+                consistent = consistent && snapshot[i].x == snapshot[0].x;
+            }
+            snapshots++;
+        }
+    });
+
+    for(size_t round = 1; round <= rounds * 10; round++)
+    {
+        ecs.forEach<Position>([round](Position &pos) {
+            pos.x = (double)round;
+        }, threadCount);
+        ecs.swapBuffers();
+    }
+
+    running = false;
+    renderer.join();
+
+    if(!consistent || snapshots == 0 || ecs.snapshot<Position>()[0].x != rounds * 10)
+    {
+        std::cerr << "Error: Buffered snapshots not consistent." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// systems of the same stage fill temporaries from their own frame arenas at the same time
+bool testFrameArenas()
+{
+    bbECS::ECS ecs;
+    populate(ecs);
+
+    std::atomic<size_t> total = 0;
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    auto collect = [&total](bbECS::ECS &ecs) {
+        bbECS::FrameVector<bbECS::EntityID> ids = ecs.frameVector<bbECS::EntityID>();
+
+        for(size_t i = 0; i < entityCount; i++)
+        {
+            ids.push_back(bbECS::EntityID{i});
+        }
+
+        total += ids.size();
+    };
+
+    ecs.addSystem<Position>(sbID, collect);
+    ecs.addSystem<Velocity>(sbID, collect);
+    ecs.addSystem<State>(sbID, collect);
+
+    for(size_t round = 0; round < rounds; round++)
+    {
+        ecs.runSystemBatch(sbID);
+    }
+
+    if(total != 3 * rounds * entityCount)
+    {
+        std::cerr << "Error: Frame arenas not separate." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    TEST_ECS(testConcurrentReads);
+    TEST_ECS(testNestedParallelLoops);
+    TEST_ECS(testConcurrentEvents);
+    TEST_ECS(testConcurrentSpawning);
+    TEST_ECS(testExternalAccessTokens);
+    TEST_ECS(testBufferedSnapshots);
+    TEST_ECS(testFrameArenas);
+
+    return 0;
+}
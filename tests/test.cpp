@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <cmath>
 
 #include "bearBonesECS.hpp"
 
@@ -20,6 +21,39 @@ struct State
     int state;
 };
 
+struct Dead {};
+
+struct Time
+{
+    double dt;
+};
+
+struct Gravity
+{
+    double g;
+};
+
+struct Hit
+{
+    int damage;
+};
+
+// hot members first, the rest is only read now and then
+struct Character
+{
+    double x, y;
+    double mass;
+    int level;
+    double history[24];
+};
+
+// waypoints past the fourth go to the blob store
+struct Path
+{
+    bbECS::BlobArray<double, 4> points;
+    double length;
+};
+
 // test adding and removing entities 
 bool testAddRemoveEntities()
 {
@@ -369,6 +403,1541 @@ bool testForEachLoopingParallel()
     return true;
 }
 
+// test forEach query terms With, Without and Optional
+bool testForEachQueryFilters()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addComponentType<Velocity>("Velocity");
+    ecs.addComponentType<State>("State");
+    ecs.addComponentType<Dead>("Dead");
+
+    for(size_t i = 0; i < 8; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Position>(ent, {0.0, 0.0});
+
+        if(i % 2 == 0) ecs.addComponent<Velocity>(ent, {1.0, 1.0});
+        if(i % 4 == 0) ecs.addComponent<Dead>(ent);
+        if(i < 2) ecs.addComponent<State>(ent, 7);
+    }
+
+    int alive = 0;
+    ecs.forEach<Position, bbECS::With<Velocity>, bbECS::Without<Dead>>([&alive](Position &pos) {
+        pos.x += 1;
+        alive++;
+    });
+
+    int withState = 0;
+    ecs.forEach<Position, bbECS::Optional<State>>([&withState](bbECS::EntityID, Position &, State *state) {
+        if(state != nullptr && state->state == 7) withState++;
+    }, 3);
+
+    if(alive != 2 || withState != 2)
+    {
+        std::cerr << "Error: forEach query terms not applied correctly." << std::endl;
+        return false;
+    }
+
+    for(size_t i = 0; i < 8; i++)
+    {
+        const Position &pos = ecs.readComponent<Position>(bbECS::EntityID{i});
+        if(pos.x != ((i % 2 == 0 && i % 4 != 0) ? 1.0 : 0.0))
+        {
+            std::cerr << "Error: forEach query terms visited the wrong entities." << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// test component signatures follow added and removed components
+bool testComponentSignatures()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addComponentType<Velocity>("Velocity");
+    ecs.addComponentType<Dead>("Dead");
+
+    bbECS::EntityGUID ent;
+    ecs.addEntity(ent)
+        .addComponent<Position>(ent, {0.0, 0.0})
+        .addComponent<Velocity>(ent, {1.0, 1.0});
+
+    bbECS::ComponentSignature moving = ecs.getSignature<Position, Velocity>();
+    bbECS::ComponentSignature dead = ecs.getSignature<Dead>();
+
+    if((ecs.getSignature(ent) & moving) != moving || (ecs.getSignature(ent) & dead).any())
+    {
+        std::cerr << "Error: Signature doesn't match added components." << std::endl;
+        return false;
+    }
+
+    ecs.removeComponent<Velocity>(ent);
+    ecs.addComponent<Dead>(ent);
+
+    if((ecs.getSignature(ent) & moving) == moving || (ecs.getSignature(ent) & dead).none())
+    {
+        std::cerr << "Error: Signature doesn't match removed components." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test parallel reductions over forEach give the same result as a sequential one
+bool testForEachReduce()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addComponentType<Velocity>("Velocity");
+
+    for(int i = 0; i < 100; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Position>(ent, {i * 0.1, 1.0});
+
+        if(i % 3 == 0) ecs.addComponent<Velocity>(ent, {1.0, 0.0});
+    }
+
+    auto sumX = [](Position &pos) { return pos.x; };
+    auto add = [](double a, double b) { return a + b; };
+
+    double sequential = ecs.forEachReduce<Position>(0.0, sumX, add);
+    double parallel = ecs.forEachReduce<Position>(0.0, sumX, add, 4);
+    double parallelAgain = ecs.forEachReduce<Position>(0.0, sumX, add, 4);
+
+    size_t moving = ecs.forEachReduce<Position, bbECS::With<Velocity>>(size_t(0), 
+        [](bbECS::EntityID, Position &) { return size_t(1); }, 
+        [](size_t a, size_t b) { return a + b; }, 3);
+
+    if(std::abs(sequential - 495.0) > 1e-9 || std::abs(parallel - sequential) > 1e-9 || parallel != parallelAgain || moving != 34)
+    {
+        std::cerr << "Error: forEachReduce result not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test sorting a pool in place and co-sorting a second pool to match
+bool testSortComponents()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addComponentType<Velocity>("Velocity");
+
+    for(int i = 0; i < 10; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Velocity>(ent, {(double)i, 0.0})
+            .addComponent<Position>(ent, {(double)((i * 7) % 10), (double)i});
+    }
+
+    ecs.removeComponent<Position>(bbECS::EntityID{2});
+
+    ecs.sortComponents<Position>([](const Position &a, const Position &b) { return a.x < b.x; });
+    ecs.sortComponentsLike<Velocity, Position>();
+
+    std::vector<double> positionOrder;
+    ecs.forEach<Position>([&positionOrder](bbECS::EntityID id, Position &pos) {
+        positionOrder.push_back(pos.x);
+        if(pos.y != (double)id.id) positionOrder.push_back(-1.0);
+    });
+
+    std::vector<double> velocityOrder;
+    ecs.forEach<Velocity>([&velocityOrder](bbECS::EntityID id, Velocity &vel) {
+        if(vel.x != (double)id.id) velocityOrder.push_back(-1.0);
+        velocityOrder.push_back(vel.x);
+    });
+
+    if(!std::is_sorted(positionOrder.begin(), positionOrder.end()) || positionOrder.size() != 9 || positionOrder.front() < 0.0)
+    {
+        std::cerr << "Error: Position pool not sorted correctly." << std::endl;
+        return false;
+    }
+
+    for(size_t i = 0; i < 9; i++)
+    {
+        // Velocity follows Position, so the ith velocity belongs to the entity with the ith position
+        if(ecs.readComponent<Position>(bbECS::EntityID{(size_t)velocityOrder[i]}).x != positionOrder[i])
+        {
+            std::cerr << "Error: Velocity pool not sorted like Position." << std::endl;
+            return false;
+        }
+    }
+
+    return velocityOrder.back() == 2.0;
+}
+
+// test owning groups keep co-iterated pools packed through adds and removes
+bool testGroups()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addComponentType<Velocity>("Velocity");
+
+    for(int i = 0; i < 6; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Position>(ent, {0.0, (double)i});
+
+        if(i % 2 == 0) ecs.addComponent<Velocity>(ent, {1.0, (double)i});
+    }
+
+    ecs.group<Position, Velocity>();
+
+    for(int i = 6; i < 10; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Velocity>(ent, {1.0, (double)i})
+            .addComponent<Position>(ent, {0.0, (double)i});
+    }
+
+    ecs.addComponent<Velocity>(bbECS::EntityID{1}, Velocity{1.0, 1.0});
+    ecs.removeComponent<Velocity>(bbECS::EntityID{4});
+    ecs.removeComponent<Position>(bbECS::EntityID{7});
+
+    int visited = 0;
+    ecs.forEach<Position, Velocity>([&visited](Position &pos, Velocity &vel) {
+        if(pos.y == vel.y) visited++;
+        pos.x += vel.x;
+    }, 2);
+
+    if(visited != 6)
+    {
+        std::cerr << "Error: Group join visited " << visited << " entities." << std::endl;
+        return false;
+    }
+
+    for(size_t i = 0; i < 10; i++)
+    {
+        bool inGroup = (i % 2 == 0 || i >= 6 || i == 1) && i != 4 && i != 7;
+        if(i == 7) continue;
+
+        if(ecs.readComponent<Position>(bbECS::EntityID{i}).x != (inGroup ? 1.0 : 0.0))
+        {
+            std::cerr << "Error: Group join modified the wrong entities." << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// test spatial index queries follow added, removed and moved components
+bool testSpatialIndex()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addMemberMeta(&Position::x, "x")
+        .addMemberMeta(&Position::y, "y");
+
+    for(int i = 0; i < 10; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<Position>(ent, {(double)i, 0.0});
+    }
+
+    ecs.addSpatialIndex<Position>({"x", "y"}, 2.0);
+
+    bbECS::EntityGUID late;
+    ecs.addEntity(late)
+        .addComponent<Position>(late, {3.5, 0.5});
+
+    std::vector<bbECS::EntityID> near = ecs.queryRadius<Position>({3.0, 0.0, 0.0}, 1.0);
+    std::vector<bbECS::EntityID> box = ecs.queryAABB<Position>({-1.0, -1.0, 0.0}, {2.5, 1.0, 0.0});
+
+    if(near.size() != 4 || box.size() != 3)
+    {
+        std::cerr << "Error: Spatial queries returned the wrong entities." << std::endl;
+        return false;
+    }
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Position>([](Position &pos) {
+            pos.y += 100.0;
+        });
+    });
+    ecs.runSystemBatch(sbID);
+
+    ecs.removeEntity(bbECS::EntityID{0});
+
+    std::vector<bbECS::EntityID> moved = ecs.queryAABB<Position>({-1.0, 99.0, 0.0}, {2.5, 101.0, 0.0});
+    if(moved.size() != 2 || ecs.queryRadius<Position>({3.0, 0.0, 0.0}, 1.0).size() != 0)
+    {
+        std::cerr << "Error: Spatial index not updated after systems ran." << std::endl;
+        return false;
+    }
+
+    for(bbECS::EntityID id : moved)
+    {
+        if(ecs.readComponent<Position>(id).x > 2.5)
+        {
+            std::cerr << "Error: Spatial index returned a stale entity." << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// test member indexes follow added, removed and written components
+bool testMemberIndex()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<State>("State")
+        .addMemberMeta(&State::state, "state");
+
+    for(int i = 0; i < 10; i++)
+    {
+        bbECS::EntityGUID ent;
+        ecs.addEntity(ent)
+            .addComponent<State>(ent, i % 5);
+    }
+
+    ecs.addMemberIndex<State>("state");
+
+    bbECS::ECS sorted;
+    sorted.addComponentType<State>("State")
+        .addMemberMeta(&State::state, "state")
+        .addMemberIndex<State>("state", bbECS::MemberIndexType::Sorted);
+
+    for(int i = 0; i < 10; i++)
+    {
+        bbECS::EntityGUID ent;
+        sorted.addEntity(ent)
+            .addComponent<State>(ent, i);
+    }
+
+    if(ecs.findByMember<State>("state", 3).size() != 2 || sorted.findByMemberRange<State>("state", 2, 5).size() != 4 ||
+       !sorted.findByMemberRange<State>("state", 5, 2).empty())
+    {
+        std::cerr << "Error: Member index lookup not correct." << std::endl;
+        return false;
+    }
+
+    ecs.removeEntity(bbECS::EntityID{3});
+    ecs.getComponent<State>(bbECS::EntityID{0}).state = 3;
+    ecs.updateMemberIndexes<State>();
+
+    std::vector<bbECS::EntityID> found = ecs.findByMember<State>("state", 3);
+    if(found.size() != 2 || ecs.findByMember<State>("state", 0).size() != 1)
+    {
+        std::cerr << "Error: Member index not updated." << std::endl;
+        return false;
+    }
+
+    for(bbECS::EntityID id : found)
+    {
+        if(ecs.readComponent<State>(id).state != 3)
+        {
+            std::cerr << "Error: Member index returned a stale entity." << std::endl;
+            return false;
+        }
+    }
+
+    // only written components are rechecked, also once their entity has been renumbered
+    ecs.getComponent<State>(bbECS::EntityID{8}).state = 7;
+    ecs.removeEntity(bbECS::EntityID{1});
+    ecs.updateMemberIndexes<State>();
+
+    found = ecs.findByMember<State>("state", 7);
+    if(found.size() != 1 || found[0].id != 1 || ecs.readComponent<State>(found[0]).state != 7)
+    {
+        std::cerr << "Error: Member index missed a written component." << std::endl;
+        return false;
+    }
+
+    // a loop may write any of them
+    ecs.forEach<State>([](State &state) {
+        state.state += 10;
+    });
+    ecs.updateMemberIndexes<State>();
+
+    if(ecs.findByMember<State>("state", 17).size() != 1 || ecs.findByMember<State>("state", 14).size() != 2)
+    {
+        std::cerr << "Error: Member index missed a loop." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test resources are shared by systems that declare them, and read-only ones by all systems
+bool testResources()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .insertResource<Time>(0.5)
+        .insertResource<Gravity>(-10.0)
+        .setReadOnly<Gravity>();
+
+    bbECS::EntityGUID ent;
+    ecs.addEntity(ent)
+        .addComponent<Position>(ent, {0.0, 0.0})
+        .addComponent<Velocity>(ent, {1.0, 0.0});
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Position, Time>(sbID, [](bbECS::ECS &ecs) {
+        double dt = ecs.resource<Time>().dt;
+        double g = ecs.readResource<Gravity>().g;
+        ecs.forEach<Position>([dt, g](Position &pos) {
+            pos.x += dt;
+            pos.y += g * dt;
+        });
+    });
+
+    ecs.addSystem<Velocity>(sbID, [](bbECS::ECS &ecs) {
+        double g = ecs.readResource<Gravity>().g;
+        bool seesTime = ecs.hasResource<Time>();
+        ecs.forEach<Velocity>([g, seesTime](Velocity &vel) {
+            vel.y += seesTime ? 0.0 : g;
+        });
+    });
+
+    ecs.runSystemBatch(sbID);
+
+    Position &pos = ecs.getComponent<Position>(ent);
+    Velocity &vel = ecs.getComponent<Velocity>(ent);
+    if (pos.x != 0.5 || pos.y != -5.0 || vel.y != -10.0)
+    {
+        std::cerr << "Error: Resources not shared correctly." << std::endl;
+        return false;
+    }
+
+    ecs.insertResource<Time>(0.25);
+    ecs.removeResource<Gravity>();
+    if (ecs.resource<Time>().dt != 0.25 || ecs.hasResource<Gravity>())
+    {
+        std::cerr << "Error: Resources not replaced or removed." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test events sent concurrently by systems are published at the end of the stage and live for two ticks
+bool testEvents()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .addEventType<Hit>(256);
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS &ecs) {
+        for(int i = 0; i < 100; i++)
+        {
+            ecs.send<Hit>(1);
+        }
+    });
+
+    ecs.addSystem<Velocity>(sbID, [](bbECS::ECS &ecs) {
+        for(int i = 0; i < 100; i++)
+        {
+            ecs.send<Hit>(2);
+        }
+    });
+
+    ecs.runSystemBatch(sbID);
+
+    bbECS::EventCursor cursor;
+    int count = 0, total = 0;
+    auto countHits = [&count, &total](const Hit &hit) {
+        count++;
+        total += hit.damage;
+    };
+
+    ecs.read<Hit>(cursor, countHits);
+    ecs.read<Hit>(cursor, countHits);
+    if(count != 200 || total != 300)
+    {
+        std::cerr << "Error: Events not published correctly." << std::endl;
+        return false;
+    }
+
+    ecs.updateEvents();
+    ecs.send<Hit>(5);
+
+    bbECS::EventCursor lateCursor;
+    count = 0;
+    ecs.read<Hit>(lateCursor, countHits);
+    if(count != 201)
+    {
+        std::cerr << "Error: Events from the last tick not readable." << std::endl;
+        return false;
+    }
+
+    count = total = 0;
+    ecs.read<Hit>(cursor, countHits);
+    ecs.updateEvents();
+    ecs.updateEvents();
+    ecs.read<Hit>(cursor, countHits);
+    if(count != 1 || total != 5)
+    {
+        std::cerr << "Error: Event cursor not correct." << std::endl;
+        return false;
+    }
+
+    // events from parallel loop workers are kept when the main thread sends more before a sync point
+    for(int i = 0; i < 10; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>(0.0, 0.0);
+    }
+    ecs.forEach<Position>([&ecs](Position&) {
+        ecs.send<Hit>(1);
+    }, 4);
+    ecs.send<Hit>(10);
+
+    count = total = 0;
+    ecs.read<Hit>(cursor, countHits);
+    if(count != 11 || total != 20)
+    {
+        std::cerr << "Error: Events from workers overwritten." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test several observers per type, and batched observers delivered at sync points
+bool testBatchedObservers()
+{
+    bbECS::ECS ecs;
+
+    int added = 0, removed = 0;
+    size_t batchAdded = 0, batchRemoved = 0;
+
+    ecs.addComponentType<Position>("Position");
+    ecs.addSystem<Position>(SYSTEM_ADD_COMPONENT, [&added](Position&) {
+        added++;
+    });
+    ecs.addSystem<Position>(SYSTEM_ADD_COMPONENT, [&added](bbECS::EntityID, Position&) {
+        added++;
+    });
+    ecs.addSystem<Position>(SYSTEM_ADD_COMPONENT_BATCH, [&batchAdded](bbECS::ECS &ecs, std::span<const bbECS::EntityGUID> guids) {
+        for(bbECS::EntityGUID guid : guids)
+        {
+            ecs.getComponent<Position>(guid).x = 1.0;
+        }
+        batchAdded += guids.size();
+    });
+    ecs.addSystem<Position>(SYSTEM_REMOVE_COMPONENT_BATCH, [&batchRemoved](bbECS::ECS&, std::span<const bbECS::EntityGUID> guids) {
+        batchRemoved += guids.size();
+    });
+    ecs.addSystem<Position>(SYSTEM_REMOVE_COMPONENT, [&removed](Position&) {
+        removed++;
+    });
+
+    std::vector<bbECS::EntityGUID> guids(10);
+    for(bbECS::EntityGUID &guid : guids)
+    {
+        ecs.addEntity(guid)
+            .addComponent<Position>(guid, {0.0, 0.0});
+    }
+
+    ecs.removeEntity(guids[0]);
+
+    if(added != 20 || removed != 1 || batchAdded != 0)
+    {
+        std::cerr << "Error: Observers not run correctly." << std::endl;
+        return false;
+    }
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS&) {});
+    ecs.runSystemBatch(sbID);
+
+    if(batchAdded != 9 || batchRemoved != 1 || ecs.getComponent<Position>(guids[9]).x != 1.0)
+    {
+        std::cerr << "Error: Batched observers not run correctly." << std::endl;
+        return false;
+    }
+
+    ecs.flushObservers();
+    if(batchAdded != 9 || batchRemoved != 1)
+    {
+        std::cerr << "Error: Batched observers run twice." << std::endl;
+        return false;
+    }
+
+    // observers that register observers and grow the pool they are called for
+    bbECS::ECS growing;
+    growing.addComponentType<Position>("Position", 1);
+
+    bool registered = false, moved = true;
+    growing.addSystem<Position>(SYSTEM_ADD_COMPONENT, [&growing, &registered](bbECS::EntityID id, Position&) {
+        if(registered || id.id != 0) return;
+        registered = true;
+
+        for(int i = 0; i < 8; i++)
+        {
+            growing.addSystem<Position>(SYSTEM_ADD_COMPONENT, [](Position&) {});
+        }
+        for(int i = 0; i < 100; i++)
+        {
+            growing.addEntity()
+                .addComponent<Position>(2.0, 2.0);
+        }
+    });
+    growing.addSystem<Position>(SYSTEM_ADD_COMPONENT, [&moved](bbECS::EntityID id, Position &pos) {
+        moved = moved && pos.x == (id.id == 0 ? 1.0 : 2.0);
+    });
+
+    growing.addEntity()
+        .addComponent<Position>(bbECS::EntityID{0}, 1.0, 1.0);
+
+    if(!moved)
+    {
+        std::cerr << "Error: Observers got a stale component." << std::endl;
+        return false;
+    }
+
+    // batch observers that register observers for other types while the flush is delivering
+    bbECS::ECS rehashing;
+    rehashing.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .addComponentType<State>("State")
+        .addComponentType<Time>("Time")
+        .addComponentType<Gravity>("Gravity");
+
+    int positionBatches = 0, velocityBatches = 0;
+    rehashing.addSystem<Position>(SYSTEM_ADD_COMPONENT_BATCH, [&positionBatches](bbECS::ECS &ecs, std::span<const bbECS::EntityGUID>) {
+        positionBatches++;
+        ecs.addSystem<State>(SYSTEM_ADD_COMPONENT_BATCH, [](bbECS::ECS&, std::span<const bbECS::EntityGUID>) {});
+        ecs.addSystem<Time>(SYSTEM_ADD_COMPONENT_BATCH, [](bbECS::ECS&, std::span<const bbECS::EntityGUID>) {});
+        ecs.addSystem<Gravity>(SYSTEM_ADD_COMPONENT_BATCH, [](bbECS::ECS&, std::span<const bbECS::EntityGUID>) {});
+    });
+    rehashing.addSystem<Velocity>(SYSTEM_ADD_COMPONENT_BATCH, [&velocityBatches](bbECS::ECS&, std::span<const bbECS::EntityGUID>) {
+        velocityBatches++;
+    });
+
+    rehashing.addEntity()
+        .addComponent<Position>(bbECS::EntityID{0}, 0.0, 0.0)
+        .addComponent<Velocity>(bbECS::EntityID{0}, 0.0, 0.0);
+    rehashing.flushObservers();
+
+    if(positionBatches != 1 || velocityBatches != 1)
+    {
+        std::cerr << "Error: Batched observers lost or repeated while observers were added." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test entities reserved from worker threads are created at the next sync point
+bool testReserveEntities()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .reserveEntitySlots(256);
+
+    for(int i = 0; i < 100; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+    }
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+
+    ecs.addSystem<Position>(sbID, [](bbECS::ECS &ecs) {
+        ecs.forEach<Position>([&ecs](Position &pos) {
+            bbECS::EntityReservation projectile = ecs.reserveEntity();
+            ecs.addComponent<Velocity>(projectile, pos.x, 1.0);
+        }, 4);
+    });
+
+    ecs.runSystemBatch(sbID);
+
+    double total = 0.0;
+    size_t count = 0;
+    ecs.forEach<Velocity>([&total, &count](Velocity &vel) {
+        total += vel.x;
+        count++;
+    });
+
+    if(count != 100 || total != 4950.0)
+    {
+        std::cerr << "Error: Reserved entities not committed correctly." << std::endl;
+        return false;
+    }
+
+    bbECS::EntityReservation reservation = ecs.reserveEntity();
+    ecs.addComponent<Position>(reservation, 1.0, 2.0)
+        .commitEntities();
+
+    if(ecs.getComponent<Position>(reservation.guid).y != 2.0)
+    {
+        std::cerr << "Error: Reserved entity not committed." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test access tokens make other threads wait for writers, and count the contention
+bool testAccessTokens()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity");
+
+    bbECS::EntityGUID ent;
+    ecs.addEntity(ent)
+        .addComponent<Position>(ent, {0.0, 0.0})
+        .addComponent<Velocity>(ent, {0.0, 0.0});
+
+    bbECS::AccessToken writeToken = ecs.acquireWrite<Position>();
+
+    double x = 0.0;
+    std::thread reader([&ecs, &x, ent]() {
+        bbECS::AccessToken velocityToken = ecs.acquireRead<Velocity>();
+        bbECS::AccessToken positionToken = ecs.acquireRead<Position>();
+        x = ecs.readComponent<Position>(ent).x;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ecs.getComponent<Position>(ent).x = 5.0;
+    writeToken.release();
+    reader.join();
+
+    bbECS::AccessStats positionStats = ecs.getAccessStats<Position>();
+    bbECS::AccessStats velocityStats = ecs.getAccessStats<Velocity>();
+    if(x != 5.0 || positionStats.writes != 1 || positionStats.contendedReads != 1 || velocityStats.contendedReads != 0)
+    {
+        std::cerr << "Error: Access tokens not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test buffered component types publish consistent copies on swapBuffers
+bool testBufferedComponents()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .setBuffered<Position>();
+
+    for(int i = 0; i < 10; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+    }
+
+    if(ecs.snapshot<Position>().size() != 0)
+    {
+        std::cerr << "Error: Snapshot published before swapBuffers." << std::endl;
+        return false;
+    }
+
+    ecs.swapBuffers();
+    bbECS::ComponentSnapshot<Position> first = ecs.snapshot<Position>();
+
+    ecs.forEach<Position>([](Position &pos) {
+        pos.y = 1.0;
+    });
+    ecs.swapBuffers();
+    ecs.swapBuffers(); // both buffers are taken, this one is skipped
+
+    bbECS::ComponentSnapshot<Position> second = ecs.snapshot<Position>();
+
+    if(first.size() != 10 || first[3].x != 3.0 || first[3].y != 0.0 || second[3].y != 1.0 ||
+       ecs.readComponent<Position>(first.getOwner(3)).x != 3.0)
+    {
+        std::cerr << "Error: Snapshots not correct." << std::endl;
+        return false;
+    }
+
+    // the buffers can't be replaced while snapshots hold them
+    ecs.setBuffered<Position>(3);
+    if(second[3].y != 1.0 || ecs.snapshot<Position>().size() != 10)
+    {
+        std::cerr << "Error: Buffers replaced while held." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test NUMA mode keeps loops correct, and falls back to normal behavior on single node machines
+bool testNumaAware()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .setNumaAware();
+
+    for(int i = 0; i < 100000; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+    }
+
+    ecs.forEach<Position>([](Position &pos) {
+        pos.y = pos.x * 2.0;
+    }, 4);
+
+    bool correct = true;
+    ecs.forEach<Position>([&correct](Position &pos) {
+        correct = correct && pos.y == pos.x * 2.0;
+    });
+
+    if(!correct || ecs.getNumaNodeCount() < 1)
+    {
+        std::cerr << "Error: NUMA aware loop not correct." << std::endl;
+        return false;
+    }
+
+    // queries without a required term have no pool to bind the workers to
+    ecs.setNumaAware(true);
+
+    size_t optional = ecs.forEachReduce<bbECS::Optional<Position>>((size_t)0,
+        [](Position *pos) { return pos != nullptr ? (size_t)1 : (size_t)0; },
+        [](size_t a, size_t b) { return a + b; }, 4);
+
+    std::atomic<size_t> visited = 0;
+    ecs.forEachDynamic({}, [&visited](bbECS::EntityID, void**) {
+        visited++;
+    }, 4);
+
+    if(optional != 100000 || visited != 100000)
+    {
+        std::cerr << "Error: NUMA aware loop without a required term not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test joins give the same results at any prefetch distance, also when the callback moves components
+bool testPrefetchDistance()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .addComponentType<State>("State")
+        .addComponentType<Dead>("Dead");
+
+    for(size_t i = 0; i < 1000; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+
+        if(i % 3 == 0) ecs.addComponent<State>((int)i);
+        if(i % 5 == 0) ecs.addComponent<Dead>();
+    }
+
+    // Velocity is added back to front so its pool is not in entity order
+    for(size_t i = 1000; i-- > 0;)
+    {
+        if(i % 2 == 0) ecs.addComponent<Velocity>(bbECS::EntityID{i}, (double)i, 1.0);
+    }
+
+    std::vector<double> sums;
+    for(size_t distance : {0, 1, 16})
+    {
+        ecs.setPrefetchDistance(distance);
+
+        double sum = 0.0;
+        ecs.forEach<Position, Velocity, bbECS::Optional<State>, bbECS::Without<Dead>>([&sum](Position &pos, Velocity &vel, State *state) {
+            sum += pos.x * vel.y + (state != nullptr ? state->state : 0.5);
+        });
+        sums.push_back(sum);
+    }
+
+    if(sums[0] != sums[1] || sums[0] != sums[2])
+    {
+        std::cerr << "Error: Prefetched join not the same as the plain one." << std::endl;
+        return false;
+    }
+
+    // removing State swaps slots that were already resolved for the entities ahead
+    ecs.setPrefetchDistance(4);
+
+    bool correct = true;
+    ecs.forEach<Position, Velocity, bbECS::Optional<State>>([&ecs, &correct](bbECS::EntityID id, Position &pos, Velocity &vel, State *state) {
+        correct = correct && pos.x == vel.x && (state == nullptr || state->state == (int)id.id);
+        if(state != nullptr) ecs.removeComponent<State>(id);
+    });
+
+    if(!correct)
+    {
+        std::cerr << "Error: Prefetched join read stale components." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test split components keep both parts together through removal, sorting and serialization
+bool testHotColdSplit()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Character>("Character")
+        .addMemberMeta(&Character::x, "x")
+        .addMemberMeta(&Character::y, "y")
+        .addMemberMeta(&Character::mass, "mass")
+        .addMemberMeta(&Character::level, "level")
+        .setHotMembers<Character>({"x", "y"});
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Character>(Character{(double)i, 0.0, i * 2.0, (int)i});
+    }
+
+    for(size_t i = 0; i < 100; i += 7)
+    {
+        ecs.removeComponent<Character>(bbECS::EntityID{i});
+    }
+
+    ecs.forEachSplit<Character>([](bbECS::SplitComponent<Character> character) {
+        character.get(&Character::y) = character.get(&Character::x) + 1.0;
+        character.get(&Character::history)[23] = character.get(&Character::mass);
+    }, 4);
+
+    ecs.sortComponents<Character>([](const Character &a, const Character &b) {
+        return a.x > b.x;
+    });
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        if(i % 7 == 0) continue;
+
+        bbECS::EntityID id{i};
+        Character character = ecs.getSplitComponent<Character>(id).load();
+        if(character.y != i + 1.0 || character.history[23] != i * 2.0 || ecs.getMember<double, Character>(id, "mass") != i * 2.0 ||
+            ecs.getMember<int, Character>(id, "level") != (int)i)
+        {
+            std::cerr << "Error: Split component parts don't match." << std::endl;
+            return false;
+        }
+    }
+
+    bbECS::EntityGUID copy;
+    ecs.addEntity(copy);
+    ecs.fromString(copy, ecs.toString(bbECS::EntityID{5}));
+
+    if(ecs.getMember<double, Character>(ecs.getEntityID(copy), "mass") != 10.0 || 
+       ecs.getSplitComponent<Character>(copy).get(&Character::y) != 6.0)
+    {
+        std::cerr << "Error: Split component not serialized whole." << std::endl;
+        return false;
+    }
+
+    ecs.getSplitComponent<Character>(copy).store(Character{1.0, 2.0, 3.0, 4});
+    if(ecs.getMember<int, Character>(ecs.getEntityID(copy), "level") != 4 || 
+       ecs.getSplitComponent<Character>(bbECS::EntityID{6}).get(&Character::level) != 6)
+    {
+        std::cerr << "Error: Split component not stored whole." << std::endl;
+        return false;
+    }
+
+    // typed access is refused, getComponent and readComponent hand out a copy of the whole component
+    bool visited = false;
+    ecs.forEach<Character>([&visited](Character&) {
+        visited = true;
+    });
+
+    const Character &read = ecs.readComponent<Character>(bbECS::EntityID{6});
+    if(visited || read.level != 6 || read.history[23] != 12.0 || ecs.getComponent<Character>(copy).mass != 3.0)
+    {
+        std::cerr << "Error: Typed access to a split component not refused." << std::endl;
+        return false;
+    }
+
+    // cold members can't be indexed, and hot members can't leave a cold gap between them
+    ecs.addMemberIndex<Character>("mass")
+        .addSpatialIndex<Character>({"x", "mass"}, 1.0);
+
+    bbECS::ECS gapped;
+    gapped.addComponentType<Character>("Character")
+        .addMemberMeta(&Character::x, "x")
+        .addMemberMeta(&Character::y, "y")
+        .addMemberMeta(&Character::mass, "mass")
+        .setHotMembers<Character>({"x", "mass"});
+    gapped.addEntity()
+        .addComponent<Character>(Character{1.0, 2.0, 3.0, 4});
+
+    bool whole = false;
+    gapped.forEach<Character>([&whole](Character &character) {
+        whole = character.mass == 3.0;
+    });
+
+    if(!ecs.findByMember<Character>("mass", 10.0).empty() || !ecs.queryRadius<Character>({5.0, 10.0, 0.0}, 1.0).empty() || !whole)
+    {
+        std::cerr << "Error: Cold member layout not refused." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test the memory report follows pools and entities as they grow and shrink
+bool testMemoryReport()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity")
+        .insertResource<Gravity>(-10.0);
+
+    for(size_t i = 0; i < 1000; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+
+        if(i % 2 == 0) ecs.addComponent<Velocity>(1.0, 1.0);
+    }
+
+    bbECS::MemoryReport full = ecs.memoryReport();
+
+    const bbECS::ComponentTypeMemory &positions = full.componentTypes[0];
+    if(positions.name != "Position" || positions.pool.used < 1000 * sizeof(Position) || 
+        positions.pool.reserved < positions.pool.used || full.resources.used < sizeof(Gravity) ||
+        full.componentMaps.used == 0 || full.total.used < positions.pool.used + full.componentMaps.used + full.entities.used)
+    {
+        std::cerr << "Error: Memory report doesn't cover the world." << std::endl;
+        return false;
+    }
+
+    for(size_t i = 1000; i-- > 10;)
+    {
+        ecs.removeEntity(bbECS::EntityID{i});
+    }
+
+    bbECS::MemoryReport shrunk = ecs.memoryReport();
+
+    if(shrunk.componentTypes[0].pool.used >= positions.pool.used || shrunk.componentMaps.used >= full.componentMaps.used ||
+        shrunk.entities.fragmentation() <= full.entities.fragmentation())
+    {
+        std::cerr << "Error: Memory report doesn't follow removals." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test systems reuse their frame arena every run instead of allocating again
+bool testFrameArena()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+
+    for(size_t i = 0; i < 1000; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+    }
+
+    size_t count = 0;
+    std::vector<size_t> reserved;
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+    ecs.addSystem<Position>(sbID, [&count, &reserved](bbECS::ECS &ecs) {
+        bbECS::FrameVector<bbECS::EntityID> candidates = ecs.frameVector<bbECS::EntityID>();
+
+        ecs.forEach<Position>([&candidates](bbECS::EntityID id, Position &pos) {
+            if(pos.x >= 500.0) candidates.push_back(id);
+        });
+
+        count = candidates.size();
+        reserved.push_back(ecs.frameArena().reserved());
+    });
+
+    for(size_t round = 0; round < 10; round++)
+    {
+        ecs.runSystemBatch(sbID);
+
+        if(count != 500 || reserved.back() != reserved.front())
+        {
+            std::cerr << "Error: Frame arena not reused between runs." << std::endl;
+            return false;
+        }
+    }
+
+    ecs.removeEntity(bbECS::EntityID{0});
+    size_t rootReserved = ecs.frameArena().reserved();
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        ecs.removeEntity(bbECS::EntityID{i});
+    }
+
+    if(ecs.frameArena().reserved() != rootReserved)
+    {
+        std::cerr << "Error: Frame arena grows with removed entities." << std::endl;
+        return false;
+    }
+
+    // what observers allocate while an entity is removed stays theirs
+    bbECS::FrameVector<double> removedX = ecs.frameVector<double>();
+    ecs.addSystem<Position>(SYSTEM_REMOVE_COMPONENT, [&removedX](Position &pos) {
+        removedX.push_back(pos.x);
+    });
+
+    for(size_t i = 0; i < 10; i++)
+    {
+        ecs.removeEntity(bbECS::EntityID{0});
+    }
+
+    bbECS::FrameVector<double> other = ecs.frameVector<double>();
+    other.assign(64, -1.0);
+
+    bool kept = removedX.size() == 10;
+    for(double x : removedX)
+    {
+        kept = kept && x >= 0.0;
+    }
+
+    if(!kept)
+    {
+        std::cerr << "Error: Frame arena handed out memory observers still use." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool testBlobArrays()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Path>("Path")
+        .addMemberMeta(&Path::points, "points")
+        .addMemberMeta(&Path::length, "length");
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Path>(Path{});
+
+        Path &path = ecs.getComponent<Path>(bbECS::EntityID{i});
+        for(size_t j = 0; j < i % 10; j++)
+        {
+            ecs.resizeBlob(path.points, j + 1);
+            ecs.blob(path.points)[j] = (double)(i + j);
+        }
+        path.length = (double)(i % 10);
+    }
+
+    for(size_t i = 0; i < 100; i += 3)
+    {
+        ecs.removeComponent<Path>(bbECS::EntityID{i});
+    }
+    ecs.compactBlobs();
+
+    bool correct = true;
+    ecs.forEach<Path>([&ecs, &correct](bbECS::EntityID id, Path &path) {
+        std::span<const double> points = ecs.readBlob(path.points);
+        correct = correct && points.size() == (size_t)path.length && id.id % 3 != 0;
+
+        for(size_t j = 0; j < points.size(); j++)
+        {
+            correct = correct && points[j] == (double)(id.id + j);
+        }
+    });
+
+    if(!correct)
+    {
+        std::cerr << "Error: Blob arrays not kept with their components." << std::endl;
+        return false;
+    }
+
+    bbECS::EntityGUID copy;
+    ecs.addEntity(copy);
+    ecs.fromString(copy, ecs.toString(bbECS::EntityID{98}));
+
+    std::span<const double> points = ecs.readBlob(ecs.readComponent<Path>(copy).points);
+    if(points.size() != 8 || points[7] != 105.0 || points.data() == ecs.readBlob(ecs.readComponent<Path>(bbECS::EntityID{98}).points).data())
+    {
+        std::cerr << "Error: Blob arrays not serialized." << std::endl;
+        return false;
+    }
+
+    if(ecs.memoryReport().blobs.used == 0)
+    {
+        std::cerr << "Error: Blob store missing from the memory report." << std::endl;
+        return false;
+    }
+
+    // a cloned component gets its own payload, removing both frees each slot once
+    bbECS::ECS clones;
+    clones.addComponentType<Path>("Path")
+        .addMemberMeta(&Path::points, "points");
+
+    std::vector<bbECS::EntityGUID> guids(4);
+    clones.addEntity(guids[0])
+        .addComponent<Path>(Path{});
+    clones.assignBlob(clones.getComponent<Path>(guids[0]).points, std::span<const double>(std::vector<double>(8, 1.0)));
+    clones.addEntity(guids[1])
+        .addComponent<Path>(clones.getComponent<Path>(guids[0]));
+
+    clones.blob(clones.getComponent<Path>(guids[1]).points)[0] = 2.0;
+    bool separate = clones.readBlob(clones.readComponent<Path>(guids[0]).points)[0] == 1.0;
+
+    clones.removeEntity(guids[0]);
+    clones.removeEntity(guids[1]);
+
+    for(size_t i = 2; i < 4; i++)
+    {
+        clones.addEntity(guids[i])
+            .addComponent<Path>(Path{});
+        clones.assignBlob(clones.getComponent<Path>(guids[i]).points, std::span<const double>(std::vector<double>(8, (double)i)));
+    }
+
+    if(!separate || clones.readBlob(clones.readComponent<Path>(guids[2]).points)[0] != 2.0 ||
+       clones.readBlob(clones.readComponent<Path>(guids[3]).points)[0] != 3.0)
+    {
+        std::cerr << "Error: Blob payloads shared between components." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool testDynamicQuery()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity");
+
+    for(size_t i = 0; i < 1000; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>(0.0, 0.0);
+
+        if(i % 2 == 0)
+        {
+            ecs.addComponent<Velocity>(1.0, (double)i);
+        }
+    }
+
+    std::vector<bbECS::ComponentTypeID> typeIDs = {ecs.getComponentTypeID<Position>(), ecs.getComponentTypeID<Velocity>()};
+    size_t visited = 0;
+
+    ecs.forEachDynamic(typeIDs, [&visited](bbECS::EntityID, void **components) {
+        Position &pos = *static_cast<Position*>(components[0]);
+        const Velocity &vel = *static_cast<const Velocity*>(components[1]);
+
+        pos.x += vel.x;
+        pos.y += vel.y;
+        visited++;
+    });
+
+    ecs.forEachDynamic(typeIDs, [](bbECS::EntityID, void **components) {
+        static_cast<Position*>(components[0])->x += 1.0;
+    }, 4);
+
+    bool correct = visited == 500;
+    ecs.forEach<Position>([&correct](bbECS::EntityID id, Position &pos) {
+        bool moved = id.id % 2 == 0;
+        correct = correct && pos.x == (moved ? 2.0 : 0.0) && pos.y == (moved ? (double)id.id : 0.0);
+    });
+
+    if(!correct)
+    {
+        std::cerr << "Error: Dynamic query not correct." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// members described in the type instead of with addMemberMeta
+struct Stats
+{
+    int strength;
+    double speed;
+    bool elite;
+
+    static constexpr auto members = std::tuple{
+        bbECS::member("strength", &Stats::strength),
+        bbECS::member("speed", &Stats::speed),
+        bbECS::member("elite", &Stats::elite),
+    };
+};
+
+// laid out like the Health type a mod registers at runtime
+struct HealthBytes
+{
+    float current, max;
+    int regen;
+};
+
+bool testRuntimeComponentTypes()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Position>("Position");
+
+    bbECS::ComponentTypeID healthID = ecs.addComponentType("Health", sizeof(HealthBytes), alignof(HealthBytes), {
+        {"current", bbECS::ECS::makeMemberMeta<float>(offsetof(HealthBytes, current))},
+        {"max", bbECS::ECS::makeMemberMeta<float>(offsetof(HealthBytes, max))},
+        {"regen", bbECS::ECS::makeMemberMeta<int>(offsetof(HealthBytes, regen))},
+    });
+
+    for(size_t i = 0; i < 100; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+
+        if(i % 4 == 0)
+        {
+            HealthBytes health{10.0f, 100.0f, (int)i};
+            ecs.addComponent(bbECS::EntityID{i}, healthID, &health);
+        }
+    }
+
+    bbECS::SystemBatchID sbID = ecs.addSystemBatch();
+    ecs.addSystem(sbID, {healthID}, [healthID](bbECS::ECS &ecs) {
+        std::vector<bbECS::ComponentTypeID> typeIDs = {healthID};
+
+        ecs.forEachDynamic(typeIDs, [](bbECS::EntityID, void **components) {
+            HealthBytes &health = *static_cast<HealthBytes*>(components[0]);
+            health.current = std::min(health.max, health.current + (float)health.regen);
+        });
+    });
+    ecs.runSystemBatch(sbID);
+
+    const HealthBytes &health = *static_cast<HealthBytes*>(ecs.getComponent(bbECS::EntityID{8}, healthID));
+    if(health.current != 18.0f || ecs.getComponentTypeID("Health") != healthID || !ecs.getSignature(bbECS::EntityID{8}).test(1))
+    {
+        std::cerr << "Error: Runtime component type not updated by its system." << std::endl;
+        return false;
+    }
+
+    bbECS::EntityGUID copy;
+    ecs.addEntity(copy);
+    ecs.fromString(copy, ecs.toString(bbECS::EntityID{8}));
+
+    const HealthBytes &copied = *static_cast<HealthBytes*>(ecs.getComponent(ecs.getEntityID(copy), healthID));
+    if(copied.current != 18.0f || copied.max != 100.0f || copied.regen != 8)
+    {
+        std::cerr << "Error: Runtime component type not serialized." << std::endl;
+        return false;
+    }
+
+    ecs.removeComponent(bbECS::EntityID{0}, healthID);
+    ecs.removeComponentType(healthID);
+    ecs.removeEntity(bbECS::EntityID{4});
+
+    if(ecs.getSignature(bbECS::EntityID{8}).test(1))
+    {
+        std::cerr << "Error: Runtime component type not removed." << std::endl;
+        return false;
+    }
+
+    // every slot taken, the next type is refused rather than indexing past the signature
+    bbECS::ECS full;
+    for(int i = 0; i < ECS_MAX_COMPONENT_TYPES; i++)
+    {
+        full.addComponentType("Type" + std::to_string(i), sizeof(float), alignof(float), {});
+    }
+
+    if(full.addComponentType("OneTooMany", sizeof(float), alignof(float), {}) != 0)
+    {
+        std::cerr << "Error: Component type past the limit not refused." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool testStaticECS()
+{
+    using World = bbECS::StaticECS<Position, Velocity, State>;
+    static_assert(World::getComponentTypeID<Velocity>() == 1);
+
+    // the same code runs on both worlds
+    auto simulate = [](auto &ecs) {
+        for(size_t i = 0; i < 1000; i++)
+        {
+            ecs.addEntity()
+                .template addComponent<Position>(0.0, 0.0);
+
+            if(i % 2 == 0) ecs.template addComponent<Velocity>(1.0, (double)i);
+            if(i % 5 == 0) ecs.template addComponent<State>((int)i);
+        }
+
+        ecs.template forEach<Position, Velocity, bbECS::Without<State>>([](Position &pos, Velocity &vel) {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        }, 4);
+
+        ecs.template forEach<Position, bbECS::Optional<State>>([](bbECS::EntityID id, Position &pos, State *state) {
+            if(state != nullptr) pos.x = (double)state->state + id.id;
+        });
+
+        for(size_t i = 0; i < 1000; i += 3)
+        {
+            ecs.template removeComponent<Position>(bbECS::EntityID{i});
+        }
+        ecs.removeEntity(bbECS::EntityID{7});
+
+        return ecs.template forEachReduce<Position, bbECS::With<Velocity>>(0.0,
+            [](const Position &pos) { return pos.x + pos.y; },
+            [](double a, double b) { return a + b; }, 3);
+    };
+
+    bbECS::ECS dynamicWorld;
+    dynamicWorld.addComponentType<Position>()
+        .addComponentType<Velocity>()
+        .addComponentType<State>();
+
+    World staticWorld;
+
+    double expected = simulate(dynamicWorld);
+    double result = simulate(staticWorld);
+
+    if(result != expected || staticWorld.getEntityCount() != 999 || 
+        staticWorld.getSignature(bbECS::EntityID{7}) != dynamicWorld.getSignature(bbECS::EntityID{7}) ||
+        staticWorld.readComponent<Position>(bbECS::EntityID{10}).x != dynamicWorld.readComponent<Position>(bbECS::EntityID{10}).x)
+    {
+        std::cerr << "Error: StaticECS doesn't match ECS." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool testMemberDescriptors()
+{
+    bbECS::ECS ecs;
+
+    ecs.addComponentType<Stats>("Stats")
+        .addMemberIndex<Stats>("strength");
+
+    for(size_t i = 0; i < 10; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Stats>((int)i % 3, i * 0.5, i > 4);
+    }
+
+    if(ecs.getMemberMeta<Stats>("speed").offset != offsetof(Stats, speed) || ecs.findByMember<Stats>("strength", 2).size() != 3)
+    {
+        std::cerr << "Error: Member descriptors not registered." << std::endl;
+        return false;
+    }
+
+    Stats stats{7, 1.5, false};
+    std::string str = ecs.toString(stats);
+
+    if(str != "{strength: 7, speed: 1.5, elite: false}")
+    {
+        std::cerr << "Error: Member descriptors not serialized in order." << std::endl;
+        return false;
+    }
+
+    bbECS::EntityGUID copy;
+    ecs.addEntity(copy);
+    ecs.fromString(copy, ecs.toString(bbECS::EntityID{5}));
+
+    const Stats &copied = ecs.readComponent<Stats>(copy);
+    if(copied.strength != 2 || copied.speed != 2.5 || !copied.elite)
+    {
+        std::cerr << "Error: Member descriptors not deserialized." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test adding and removing a component type on many entities at once
+bool testBatchAddRemove()
+{
+    bbECS::ECS ecs;
+    ecs.addComponentType<Position>("Position")
+        .addComponentType<Velocity>("Velocity", 4);
+
+    size_t added = 0, removed = 0, batchAdded = 0;
+    bool inPlace = true;
+    bbECS::FrameVector<bbECS::EntityID> seen = ecs.frameVector<bbECS::EntityID>();
+
+    ecs.addSystem<Velocity>(SYSTEM_ADD_COMPONENT, [&ecs, &added, &inPlace, &seen](bbECS::EntityID id, Velocity &vel) {
+        // every component of the batch is placed before the first observer runs
+        inPlace = inPlace && (vel.y == 2.0 || vel.x == (double)id.id) && ecs.getSignature(bbECS::EntityID{98}).count() == 2;
+        seen.push_back(id);
+        added++;
+    });
+    ecs.addSystem<Velocity>(SYSTEM_REMOVE_COMPONENT, [&removed](Velocity&) {
+        removed++;
+    });
+    ecs.addSystem<Velocity>(SYSTEM_ADD_COMPONENT_BATCH, [&batchAdded](bbECS::ECS&, std::span<const bbECS::EntityGUID> guids) {
+        batchAdded += guids.size();
+    });
+
+    std::vector<bbECS::EntityID> even, odd;
+    for(size_t i = 0; i < 100; i++)
+    {
+        ecs.addEntity()
+            .addComponent<Position>((double)i, 0.0);
+        (i % 2 == 0 ? even : odd).push_back(bbECS::EntityID{i});
+    }
+
+    ecs.addComponents<Velocity>(even, [](bbECS::EntityID id) { return Velocity{(double)id.id, 1.0}; });
+    ecs.addComponents<Velocity>(odd, Velocity{0.0, 2.0});
+    ecs.flushObservers();
+
+    bbECS::FrameVector<bbECS::EntityID> other = ecs.frameVector<bbECS::EntityID>();
+    other.assign(128, bbECS::EntityID{SIZE_MAX});
+
+    if(added != 100 || seen.size() != 100 || seen[99].id != 99 || batchAdded != 100 || !inPlace || ecs.readComponent<Velocity>(bbECS::EntityID{41}).y != 2.0)
+    {
+        std::cerr << "Error: Components not added in a batch." << std::endl;
+        return false;
+    }
+
+    ecs.removeComponents<Velocity>(even);
+
+    size_t count = 0;
+    bool correct = true;
+    ecs.forEach<Position, Velocity>([&count, &correct](Position &pos, Velocity &vel) {
+        count++;
+        correct = correct && (int)pos.x % 2 == 1 && vel.y == 2.0;
+    });
+
+    if(removed != 50 || count != 50 || !correct || ecs.getSignature(bbECS::EntityID{10}).count() != 1)
+    {
+        std::cerr << "Error: Components not removed in a batch." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 int main()
 {
     // Run tests
@@ -384,6 +1953,30 @@ int main()
     TEST_ECS(testAddRemoveComponentSystems);
     TEST_ECS(testForEachLooping);
     TEST_ECS(testForEachLoopingParallel);
+    TEST_ECS(testForEachQueryFilters);
+    TEST_ECS(testComponentSignatures);
+    TEST_ECS(testForEachReduce);
+    TEST_ECS(testSortComponents);
+    TEST_ECS(testGroups);
+    TEST_ECS(testSpatialIndex);
+    TEST_ECS(testMemberIndex);
+    TEST_ECS(testResources);
+    TEST_ECS(testEvents);
+    TEST_ECS(testBatchedObservers);
+    TEST_ECS(testReserveEntities);
+    TEST_ECS(testAccessTokens);
+    TEST_ECS(testBufferedComponents);
+    TEST_ECS(testNumaAware);
+    TEST_ECS(testPrefetchDistance);
+    TEST_ECS(testHotColdSplit);
+    TEST_ECS(testMemoryReport);
+    TEST_ECS(testFrameArena);
+    TEST_ECS(testBlobArrays);
+    TEST_ECS(testDynamicQuery);
+    TEST_ECS(testRuntimeComponentTypes);
+    TEST_ECS(testStaticECS);
+    TEST_ECS(testMemberDescriptors);
+    TEST_ECS(testBatchAddRemove);
 
 
     return 0;